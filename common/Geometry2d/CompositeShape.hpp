@@ -5,12 +5,22 @@
 #include "Segment.hpp"
 #include <vector>
 #include <memory>
-#include <set>
+#include <bitset>
+#include <algorithm>
 
 class Obstacle;
 
 namespace Geometry2d {
 
+    /**
+     * Set of the shapes in a CompositeShape, by their index in subshapes().
+     *
+     * This is a fixed-size bitmask so that hit sets can be built and compared
+     * without allocating.  Shapes past the last bit all share the last bit, which then
+     * only says that at least one of them is in the set.
+     */
+    typedef std::bitset<128> ShapeSet;
+
     /**
      * A Geometry2d::CompositeShape is a Shape that is made up of other shapes.
      */
@@ -61,31 +71,53 @@ namespace Geometry2d {
          * Checks if a given object hits obstacles in the group
          *
          * @param obj The object to collision test
-         * @param hitSet A set to add the colliding obstacles to
+         * @param hitSet The set to add the indices of the colliding obstacles to
          * @return A bool telling whether or not there were any collisions
          */
         template<typename T>
-        bool hit(const T &obj, std::set<std::shared_ptr<Shape> > &hitSet) const
+        bool hit(const T &obj, ShapeSet &hitSet) const
         {
-            for (const_iterator it = begin(); it != end(); ++it)
+            const size_t last = hitSet.size() - 1;
+            for (size_t i = 0; i < _subshapes.size(); ++i)
             {
-                if ((*it)->hit(obj))
+                if (_subshapes[i]->hit(obj))
                 {
-                    hitSet.insert(*it);
+                    hitSet.set(std::min(i, last));
                 }
             }
 
-            return !hitSet.empty();
+            return hitSet.any();
         }
 
-        bool hit(const Point &pt, std::set<std::shared_ptr<Shape> > &hitSet) const {
+        bool hit(const Point &pt, ShapeSet &hitSet) const {
             return hit<Point>(pt, hitSet);
         }
 
-        bool hit(const Segment &seg, std::set<std::shared_ptr<Shape> > &hitSet) const {
+        bool hit(const Segment &seg, ShapeSet &hitSet) const {
             return hit<Segment>(seg, hitSet);
         }
 
+        /**
+         * Checks if moving along @seg enters any obstacle that isn't in @startHit,
+         * which must be the set of obstacles containing the start of the segment.
+         * Obstacles that the segment starts in can be left without counting as a hit.
+         */
+        bool hitNew(const Segment &seg, const ShapeSet &startHit) const {
+            const size_t last = startHit.size() - 1;
+            for (size_t i = 0; i < _subshapes.size(); ++i)
+            {
+                // Obstacles in startHit don't need to be tested at all.  Past the last bit,
+                // each obstacle has to be checked for the start itself.
+                const bool started = (i < last) ? startHit[i] : (startHit[last] && _subshapes[i]->hit(seg.pt[0]));
+                if (!started && _subshapes[i]->hit(seg))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
         /**
          * Checks if a given shape is in it
          *
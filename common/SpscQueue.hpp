@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <stddef.h>
+
+/**
+ * @brief Bounded lock-free queue for exactly one producer thread and one consumer thread
+ *
+ * @details
+ * Slots are allocated once when the queue is constructed, so push() and pop() never
+ * allocate and never block.  push() fails when the queue is full and pop() fails when
+ * it is empty; it is up to the caller to decide what to do in those cases.
+ *
+ * Only one thread may call push() and only one thread may call pop() at a time.
+ * If more than one thread needs to consume, they must serialize pop() themselves
+ * (for example with a mutex that only consumers take).
+ *
+ * Capacity must be a power of two.
+ */
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+	SpscQueue():
+		_head(0),
+		_tail(0)
+	{
+	}
+
+	/// Moves @value into the queue.  Returns false (and leaves @value alone) if the queue is full.
+	bool push(T &value)
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _head.load(std::memory_order_acquire) == Capacity)
+		{
+			return false;
+		}
+
+		_slots[tail & (Capacity - 1)] = std::move(value);
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// Moves the oldest value into @value.  Returns false if the queue is empty.
+	bool pop(T &value)
+	{
+		size_t head = _head.load(std::memory_order_relaxed);
+		if (head == _tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		value = std::move(_slots[head & (Capacity - 1)]);
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// Number of queued values.  This is only a snapshot if the other thread is active.
+	size_t size() const
+	{
+		return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+	}
+
+	static size_t capacity()
+	{
+		return Capacity;
+	}
+
+private:
+	T _slots[Capacity];
+
+	// Index of the next value to pop.  Only written by the consumer.
+	// The indices increase forever and are wrapped when indexing _slots.
+	std::atomic<size_t> _head;
+
+	// Index of the next slot to push into.  Only written by the producer.
+	std::atomic<size_t> _tail;
+};
@@ -177,34 +177,6 @@ protected:
 	Coeffs _coeffs;
 };
 
-// An output iterator which throws an exception when it's used.
-// This is used for example to determine if the output of set_difference would be non-empty without
-// calculating all of it.
-template<typename T>
-class ExceptionIterator: public std::iterator<std::output_iterator_tag, void, void, void, void>
-{
-public:
-	ExceptionIterator &operator=(const T &value)
-	{
-		throw std::exception();
-	}
-
-	ExceptionIterator &operator*()
-	{
-		return *this;
-	}
-
-	ExceptionIterator &operator++()
-	{
-		return *this;
-	}
-
-	ExceptionIterator &operator++(int)
-	{
-		return *this;
-	}
-};
-
 // Sets str to the name of a class.
 // Use it like this:
 //		Object *obj = new Object();
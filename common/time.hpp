@@ -1,5 +1,10 @@
 #pragma once
 
+#include <errno.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <time.h>
+
 
 /// type for storing time in microseconds
 typedef uint64_t Time;
@@ -13,3 +18,32 @@ static inline Time timestamp()
 
     return (Time)time.tv_sec * 1000000 + (Time)time.tv_usec;
 }
+
+/**
+ * returns a monotonic timestamp in microseconds.
+ * This is not related to timestamp() and is only useful for measuring intervals
+ * and scheduling, since it never jumps when the system clock is adjusted.
+ */
+static inline Time monotonicTimestamp()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (Time)time.tv_sec * 1000000 + (Time)time.tv_nsec / 1000;
+}
+
+/**
+ * Sleeps until the given monotonicTimestamp().
+ * The deadline is absolute, so time spent before calling this does not accumulate as drift.
+ */
+static inline void sleepUntil(Time deadline)
+{
+    struct timespec ts;
+    ts.tv_sec = deadline / 1000000;
+    ts.tv_nsec = (deadline % 1000000) * 1000;
+
+    // clock_nanosleep returns EINTR if a signal interrupted it, so just go back to sleep.
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR)
+    {
+    }
+}
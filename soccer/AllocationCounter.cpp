@@ -0,0 +1,37 @@
+#include "AllocationCounter.hpp"
+
+#include <stdlib.h>
+#include <new>
+
+static unsigned long allocations = 0;
+
+unsigned long allocationCount()
+{
+	return allocations;
+}
+
+void *operator new(size_t size)
+{
+	++allocations;
+	void *p = malloc(size ? size : 1);
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+/**
+ * @brief Counts every heap allocation in the process.
+ *
+ * @details Linking AllocationCounter.cpp into an executable replaces the global
+ * operator new and delete, so allocations made anywhere, including in robocup,
+ * are counted.  It is only linked into the benchmarks.
+ *
+ * The counter isn't atomic, so counts are only exact in a single-threaded program.
+ */
+unsigned long allocationCount();
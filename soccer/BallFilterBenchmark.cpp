@@ -0,0 +1,206 @@
+// Measures the ball filters on a simulated ball that is kicked and deflected.
+//
+// Every camera sees the ball on every frame, which is the most work the filter
+// can be given.  The time per frame should stay well inside the 1 ms budget for
+// the ball at the configured particle count.
+//
+// usage: ball-filter-benchmark [cameras] [seed]
+
+#include <modeling/BallFilter.hpp>
+#include <modeling/RbpfBallFilter.hpp>
+#include <modeling/BallTracker.hpp>
+#include <Constants.hpp>
+#include <time.hpp>
+#include <AllocationCounter.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+using namespace std;
+using namespace Geometry2d;
+
+//// Simulated ball ////
+
+static const float Frame_Period = 1.0f / 60;
+static const int Num_Frames = 240;
+
+// Rolling friction, matching the filter's model
+static const float Deceleration = 0.4;
+
+// Standard deviation of the simulated vision
+static const float Vision_Noise = 0.003;
+
+// Frames at which things happen to the ball
+static const int Kick_Frame = 60;
+static const int Deflect_Frame = 120;
+
+struct Frame
+{
+	Point pos;
+	Point vel;
+
+	// True if a robot is touching the ball on this frame
+	bool nearRobot;
+};
+
+// A slow ball is kicked hard by a robot, then glances off of another one
+static void simulate(vector<Frame> &frames)
+{
+	frames.resize(Num_Frames);
+
+	Point pos(0, 1);
+	Point vel(0.5, 0.2);
+	for (int i = 0; i < Num_Frames; ++i)
+	{
+		bool nearRobot = false;
+		if (i == Kick_Frame)
+		{
+			vel = Point(1, 3).normalized() * 6;
+			nearRobot = true;
+		} else if (i == Deflect_Frame)
+		{
+			vel = Point(-vel.x * 0.7f, vel.y * 0.5f);
+			nearRobot = true;
+		}
+
+		frames[i].pos = pos;
+		frames[i].vel = vel;
+		frames[i].nearRobot = nearRobot;
+
+		const float speed = vel.mag();
+		const float t = min(Frame_Period, speed / Deceleration);
+		const Point next = (speed > 0) ? vel * ((speed - Deceleration * t) / speed) : Point();
+		pos += (vel + next) * (t / 2);
+		vel = next;
+	}
+}
+
+//// Benchmarks ////
+
+struct Result
+{
+	double usPerFrame;
+	double allocationsPerFrame;
+	double velocityRms;
+
+	// Frames after each kick until the velocity is within 0.5 m/s
+	int kickLag;
+	int deflectLag;
+};
+
+// Runs the filters over the frames: BallFilter if @particles is zero, otherwise an RbpfBallFilter
+static Result run(const vector<Frame> &frames, int cameras, int particles, long seed)
+{
+	unsigned short randomState[3] = {4, 5, (unsigned short)seed};
+
+	// Observations are made ahead of time so only the filter is measured
+	vector<BallObservation> obs;
+	obs.reserve(frames.size() * cameras);
+	const Time start = 1000000;
+	for (unsigned int i = 0; i < frames.size(); ++i)
+	{
+		for (int c = 0; c < cameras; ++c)
+		{
+			// Uniform, with about the same standard deviation as Vision_Noise
+			Point noise(erand48(randomState) - 0.5, erand48(randomState) - 0.5);
+			obs.push_back(BallObservation(frames[i].pos + noise * (Vision_Noise * sqrtf(12)), start + i * Frame_Period * SecsToTimestamp));
+		}
+	}
+
+	BallFilter *filter = particles ? new RbpfBallFilter(particles) : new BallFilter();
+	RbpfBallFilter *rbpf = dynamic_cast<RbpfBallFilter *>(filter);
+
+	Result result = {0, 0, 0, -1, -1};
+	double velocitySq = 0;
+	Time totalTime = 0;
+	unsigned long totalAllocations = 0;
+
+	for (unsigned int i = 0; i < frames.size(); ++i)
+	{
+		Ball ball;
+
+		const unsigned long startAllocations = allocationCount();
+		const Time startTime = monotonicTimestamp();
+		for (int c = 0; c < cameras; ++c)
+		{
+			const BallObservation &o = obs[i * cameras + c];
+			if (rbpf)
+			{
+				rbpf->update(o.pos, o.time, frames[i].nearRobot ? 0.3f : 0.01f);
+			} else if (c == 0)
+			{
+				// BallFilter can't take two observations at the same time.
+				// BallTracker only gives it one per frame.
+				filter->update(&o, 0);
+			}
+		}
+		filter->predict(obs[i * cameras].time, &ball, 0);
+		totalTime += monotonicTimestamp() - startTime;
+		totalAllocations += allocationCount() - startAllocations;
+
+		const float error = ball.vel.distTo(frames[i].vel);
+		velocitySq += error * error;
+
+		if (error < 0.5f)
+		{
+			if (i >= Kick_Frame && i < Deflect_Frame && result.kickLag < 0)
+			{
+				result.kickLag = i - Kick_Frame;
+			}
+			if (i >= Deflect_Frame && result.deflectLag < 0)
+			{
+				result.deflectLag = i - Deflect_Frame;
+			}
+		}
+	}
+
+	delete filter;
+
+	result.usPerFrame = (double)totalTime / frames.size();
+	result.allocationsPerFrame = (double)totalAllocations / frames.size();
+	result.velocityRms = sqrt(velocitySq / frames.size());
+	return result;
+}
+
+static void print(const char *name, const Result &r)
+{
+	printf("%-16s %8.1f us/frame %6.1f allocs/frame   vel rms %5.2f m/s   kick lag %3d   deflect lag %3d frames\n",
+			name, r.usPerFrame, r.allocationsPerFrame, r.velocityRms, r.kickLag, r.deflectLag);
+}
+
+int main(int argc, char *argv[])
+{
+	int cameras = 4;
+	long seed = 1;
+	if (argc > 1)
+	{
+		cameras = atoi(argv[1]);
+	}
+	if (argc > 2)
+	{
+		seed = atol(argv[2]);
+	}
+	if (cameras <= 0)
+	{
+		printf("usage: %s [cameras] [seed]\n", argv[0]);
+		return 1;
+	}
+
+	vector<Frame> frames;
+	simulate(frames);
+
+	printf("%d cameras, %d frames, seed %ld\n", cameras, Num_Frames, seed);
+	printf("(lag is -1 if the velocity never came within 0.5 m/s)\n\n");
+
+	print("alpha", run(frames, cameras, 0, seed));
+	for (int particles = 16; particles <= RbpfBallFilter::Max_Particles; particles *= 2)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "rbpf %d", particles);
+		print(name, run(frames, cameras, particles, seed));
+	}
+
+	return 0;
+}
@@ -179,7 +179,7 @@ void FieldView::drawWorldSpace(QPainter& p)
 	for (int i = 1; i < pastLocationCount + 1 && i < _history->size(); i++) {
 		const LogFrame *oldFrame = _history->at(i).get();
 		if (oldFrame) {
-			for (const SSL_WrapperPacket &wrapper : oldFrame->raw_vision()) {
+			for (const SSL_WrapperPacket &wrapper : rawVision(*oldFrame, _rawVision)) {
 				if (!wrapper.has_detection()) {
 					//	useless
 					continue;
@@ -216,7 +216,7 @@ void FieldView::drawWorldSpace(QPainter& p)
 	{
 		tempPen.setColor(QColor(0xcc, 0xcc, 0xcc));
 		p.setPen(tempPen);
-		for (const SSL_WrapperPacket& wrapper :  frame->raw_vision())
+		for (const SSL_WrapperPacket& wrapper :  rawVision(*frame, _rawVision))
 		{
 			if (!wrapper.has_detection())
 			{
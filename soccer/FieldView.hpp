@@ -83,4 +83,7 @@ class FieldView : public QWidget
 		const std::vector<std::shared_ptr<Packet::LogFrame> > *_history;
 		
 		QVector<bool> _layerVisible;
+		
+		// Vision packets parsed from frames that were logged with raw_vision_bytes
+		google::protobuf::RepeatedPtrField<SSL_WrapperPacket> _rawVision;
 };
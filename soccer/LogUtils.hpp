@@ -20,3 +20,25 @@ static inline uint32_t color(const QColor &color)
 {
 	return (color.red() << 16) | (color.green() << 8) | (color.blue());
 }
+
+/// Returns the vision packets in @frame.
+/// If the frame holds unparsed datagrams (raw_vision_bytes), they are parsed into @scratch,
+/// which is cleared first so its allocations are reused between calls.
+static inline const google::protobuf::RepeatedPtrField<SSL_WrapperPacket> &rawVision(
+	const Packet::LogFrame &frame, google::protobuf::RepeatedPtrField<SSL_WrapperPacket> &scratch)
+{
+	if (frame.raw_vision_bytes_size() == 0)
+	{
+		return frame.raw_vision();
+	}
+	
+	scratch.Clear();
+	for (const std::string &bytes : frame.raw_vision_bytes())
+	{
+		if (!scratch.Add()->ParseFromString(bytes))
+		{
+			scratch.RemoveLast();
+		}
+	}
+	return scratch;
+}
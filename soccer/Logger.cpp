@@ -4,31 +4,54 @@
 #include <boost/make_shared.hpp>
 #include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
 
 using namespace std;
 using namespace Packet;
 using namespace google::protobuf::io;
 
-Logger::Logger()
+/// How often the writer thread wakes up to write queued frames, in microseconds
+static const int WriterPeriod = 100 * 1000;
+
+Logger::Logger(int historySize):
+	_writer(this)
 {
 	_fd = -1;
-	_history.resize(100000);
+	
+	// The history must be longer than the queue so a frame leaves the queue
+	// before its slot is reused.
+	_history.resize(max(historySize, (int)QueueSize + 1));
+	_frameSpace.resize(_history.size(), 0);
+	_freeFrames.reserve(FreeFrames);
+	_retiredFrames.reserve(FreeFrames);
 	_nextFrameNumber = 0;
 	_spaceUsed = sizeof(_history[0]) * _history.size();
+	_dropPolicy = DropNewest;
+	_maxQueued = 0;
+	_dropped = 0;
+	_framesWritten = 0;
+	_bytesWritten = 0;
+	
+	_running = true;
+	_writer.start();
 }
 
 Logger::~Logger()
 {
+	_running = false;
+	_writer.wait();
+	
 	close();
 }
 
 bool Logger::open(QString filename)
 {
-	QMutexLocker locker(&_mutex);
+	QMutexLocker locker(&_fileMutex);
 	
 	if (_fd >= 0)
 	{
-		close();
+		flushQueue();
+		closeFile();
 	}
 	
 	_fd = creat(filename.toLatin1(), 0666);
@@ -45,7 +68,13 @@ bool Logger::open(QString filename)
 
 void Logger::close()
 {
-	QMutexLocker locker(&_mutex);
+	QMutexLocker locker(&_fileMutex);
+	flushQueue();
+	closeFile();
+}
+
+void Logger::closeFile()
+{
 	if (_fd >= 0)
 	{
 		::close(_fd);
@@ -56,64 +85,193 @@ void Logger::close()
 
 void Logger::addFrame(shared_ptr<LogFrame> frame)
 {
-	QMutexLocker locker(&_mutex);
+	QueuedFrame queued;
+	queued.frame = frame;
+	queued.sequence = _nextFrameNumber;
 	
-	// Write this from to the file
-	if (_fd >= 0)
+	// Get the place in the circular buffer where we will store this frame
+	int i = queued.sequence % _history.size();
+	
+	// Store the frame
+	shared_ptr<LogFrame> old = atomic_exchange(&_history[i], frame);
+	
+	// Keep the frame we replaced for reuse.
+	// It is no longer in the history, so no reader can get a new copy of it
+	// and the use count can't go up behind our back.  If the writer thread or
+	// a reader still has it, wait for them to let go.
+	if (old)
 	{
-		if (frame->IsInitialized())
+		if (old.use_count() == 1)
 		{
-			uint32_t size = frame->ByteSize();
-			if (write(_fd, &size, sizeof(size)) != sizeof(size))
+			if (_freeFrames.size() < FreeFrames)
 			{
-				printf("Logger: Failed to write size, closing log: %m\n");
-				close();
-			} else if (!frame->SerializeToFileDescriptor(_fd))
+				_freeFrames.push_back(std::move(old));
+			}
+		} else if (_retiredFrames.size() < FreeFrames)
+		{
+			_retiredFrames.push_back(std::move(old));
+		}
+	}
+	
+	// Go to the next frame.
+	// This makes the new frame visible to readers.
+	++_nextFrameNumber;
+	
+	// Hand the frame to the writer thread
+	while (!_queue.push(queued))
+	{
+		if (_dropPolicy == DropNewest)
+		{
+			// The writer thread will never see this frame, so account for its space here.
+			// The writer can't be working on this slot: everything in the queue is newer
+			// than the frame this one replaced, because the history is longer than the queue.
+			accountSpace(i, *frame);
+			++_dropped;
+			return;
+		}
+		
+		// See Processor for why we can't use QThread::usleep()
+		::usleep(1000);
+	}
+	
+	int queuedNow = _queue.size();
+	if (queuedNow > _maxQueued)
+	{
+		_maxQueued = queuedNow;
+	}
+}
+
+void Logger::writerLoop()
+{
+	while (_running)
+	{
+		::usleep(WriterPeriod);
+		
+		QMutexLocker locker(&_fileMutex);
+		flushQueue();
+	}
+}
+
+void Logger::flushQueue()
+{
+	QueuedFrame queued;
+	int frames = 0;
+	_buffer.clear();
+	while (_queue.pop(queued))
+	{
+		const LogFrame &frame = *queued.frame;
+		
+		accountSpace(queued.sequence % _history.size(), frame);
+		
+		if (_fd >= 0)
+		{
+			if (frame.IsInitialized())
 			{
-				printf("Logger: Failed to write frame, closing log: %m\n");
-				close();
+				uint32_t size = frame.ByteSize();
+				_buffer.append((const char *)&size, sizeof(size));
+				frame.AppendToString(&_buffer);
+				++frames;
+			} else {
+				printf("Logger: Not writing frame missing fields: %s\n", frame.InitializationErrorString().c_str());
 			}
-		} else {
-			printf("Logger: Not writing frame missing fields: %s\n", frame->InitializationErrorString().c_str());
 		}
+		
+		queued.frame.reset();
 	}
 	
-	// Get the place in the circular buffer where we will store this frame
-	int i = _nextFrameNumber % _history.size();
+	// Write all the frames at once
+	size_t done = 0;
+	while (_fd >= 0 && done < _buffer.size())
+	{
+		ssize_t n = write(_fd, _buffer.data() + done, _buffer.size() - done);
+		if (n < 0)
+		{
+			printf("Logger: Failed to write frames, closing log: %m\n");
+			closeFile();
+			return;
+		}
+		done += n;
+	}
 	
-	if (_history[i])
+	_framesWritten += frames;
+	_bytesWritten += done;
+}
+
+void Logger::accountSpace(int i, const LogFrame &frame)
+{
+	// Account for the space used by this frame and the one it replaced in the history
+	int space = frame.SpaceUsed();
+	_spaceUsed += space - _frameSpace[i];
+	_frameSpace[i] = space;
+}
+
+Logger::WriterStats Logger::writerStats() const
+{
+	WriterStats stats;
+	stats.queued = _queue.size();
+	stats.maxQueued = _maxQueued;
+	stats.dropped = _dropped;
+	stats.framesWritten = _framesWritten;
+	stats.bytesWritten = _bytesWritten;
+	return stats;
+}
+
+shared_ptr<LogFrame> Logger::createFrame()
+{
+	// Pick up retired frames that everyone else has let go of
+	for (size_t i = 0; i < _retiredFrames.size() && _freeFrames.size() < FreeFrames;)
 	{
-		// Remove the space used by the old data
-		_spaceUsed -= _history[i]->SpaceUsed();
+		if (_retiredFrames[i].use_count() == 1)
+		{
+			_freeFrames.push_back(std::move(_retiredFrames[i]));
+			_retiredFrames[i] = std::move(_retiredFrames.back());
+			_retiredFrames.pop_back();
+		} else {
+			++i;
+		}
 	}
 	
-	// Create a new LogFrame
-	_history[i] = frame;
+	shared_ptr<LogFrame> frame;
+	if (!_freeFrames.empty())
+	{
+		frame = std::move(_freeFrames.back());
+		_freeFrames.pop_back();
+	}
 	
-	// Add space used by the new data
-	_spaceUsed += _history[i]->SpaceUsed();
+	if (frame)
+	{
+		// Clear keeps allocated submessages around to be reused
+		frame->Clear();
+	} else {
+		frame = std::make_shared<LogFrame>();
+	}
 	
-	// Go to the next frame
-	++_nextFrameNumber;
+	return frame;
 }
 
 shared_ptr<LogFrame> Logger::lastFrame() const
 {
-	QMutexLocker locker(&_mutex);
-	return _history[(_nextFrameNumber - 1) % _history.size()];
+	int last = _nextFrameNumber - 1;
+	if (last < 0)
+	{
+		return shared_ptr<LogFrame>();
+	}
+	
+	return atomic_load(&_history[last % _history.size()]);
 }
 
 int Logger::getFrames(int start, vector<shared_ptr<LogFrame> > &frames) const
 {
-	QMutexLocker locker(&_mutex);
+	// Only read this once, since the processing thread may add frames while we copy
+	int next = _nextFrameNumber;
 	
-	int minFrame = _nextFrameNumber - (int)_history.size();
+	int minFrame = next - (int)_history.size();
 	if (minFrame < 0)
 	{
 		minFrame = 0;
 	}
 	
-	if (start < minFrame || start >= _nextFrameNumber)
+	if (start < minFrame || start >= next)
 	{
 		return 0;
 	}
@@ -127,7 +285,7 @@ int Logger::getFrames(int start, vector<shared_ptr<LogFrame> > &frames) const
 	int n = start - end + 1;
 	for (int i = 0; i < n; ++i)
 	{
-		frames[i] = _history[(start - i) % _history.size()];
+		frames[i] = atomic_load(&_history[(start - i) % _history.size()]);
 	}
 	
 	for (int i = n; i < (int)frames.size(); ++i)
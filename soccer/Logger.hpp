@@ -22,23 +22,72 @@
  *
  * Frames are allocated as they are first needed.  The size of the circular buffer
  * limits total memory usage.
+ *
+ * Serialization and file I/O happen on a separate writer thread so that disk latency
+ * never stalls the processing loop.  addFrame() stores the frame in the history and
+ * pushes it onto a bounded lock-free queue.  The writer thread periodically drains the
+ * queue, serializes all pending frames into one buffer, and writes it with a single
+ * syscall.  If the writer falls behind and the queue fills up, the DropPolicy decides
+ * whether frames are dropped from the file or addFrame() waits for space.
+ *
+ * Frames that fall out of the history are kept in a small pool and handed out
+ * again by createFrame().  A cleared LogFrame keeps the memory of its repeated
+ * fields and strings, so filling a recycled frame does very little allocation.
+ * Until the history has filled once every frame is newly allocated, so the history
+ * is kept short enough that this warm-up is over early in a match.  The log file
+ * has every frame.
  */
 
 #pragma once
 
 #include <protobuf/LogFrame.pb.h>
+#include <SpscQueue.hpp>
 
 #include <QString>
 #include <QMutexLocker>
 #include <QMutex>
+#include <QThread>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <string>
 
 class Logger
 {
 	public:
-		Logger();
+		/// What addFrame() does when the writer thread's queue is full
+		enum DropPolicy
+		{
+			/// Don't write the new frame to the file (it is still kept in the history)
+			DropNewest,
+			
+			/// Wait for the writer thread to make room.  This stalls the caller.
+			Block
+		};
+		
+		/// Writer thread statistics
+		struct WriterStats
+		{
+			/// Frames currently waiting to be written
+			int queued;
+			
+			/// Largest number of frames that have been waiting at once
+			int maxQueued;
+			
+			/// Frames that were not written because the queue was full
+			int dropped;
+			
+			int framesWritten;
+			uint64_t bytesWritten;
+		};
+		
+		/// Default length of the history: five minutes at 60 Hz
+		static const int DefaultHistorySize = 5 * 60 * 60;
+		
+		/// @historySize is the number of frames kept in memory.
+		/// It is raised if needed to be longer than the writer thread's queue.
+		Logger(int historySize = DefaultHistorySize);
 		~Logger();
 		
 		bool open(QString filename);
@@ -47,14 +96,12 @@ class Logger
 		// Returns the number of available frames
 		int numFrames() const
 		{
-			QMutexLocker locker(&_mutex);
-			return std::min(_nextFrameNumber, (int)_history.size());
+			return std::min((int)_nextFrameNumber, (int)_history.size());
 		}
 		
 		// Returns the size of the circular buffer
 		int maxFrames() const
 		{
-			QMutexLocker locker(&_mutex);
 			return _history.size();
 		}
 		
@@ -62,12 +109,12 @@ class Logger
 		// Returns -1 if no frames have been added.
 		int firstFrameNumber() const
 		{
-			QMutexLocker locker(&_mutex);
-			if (_nextFrameNumber == 0)
+			int next = _nextFrameNumber;
+			if (next == 0)
 			{
 				return -1;
 			} else {
-				return std::max(0, _nextFrameNumber - (int)_history.size());
+				return std::max(0, next - (int)_history.size());
 			}
 		}
 		
@@ -75,12 +122,18 @@ class Logger
 		// Returns -1 if no frames have been added.
 		int lastFrameNumber() const
 		{
-			QMutexLocker locker(&_mutex);
 			return _nextFrameNumber - 1;
 		}
 		
+		// Returns the most recently added frame, or null if no frames have been added.
 		std::shared_ptr<Packet::LogFrame> lastFrame() const;
 		
+		/// Returns an empty LogFrame to be filled in and passed to addFrame().
+		/// This reuses a frame that has been removed from the history if one is available.
+		///
+		/// This must only be called from the thread that calls addFrame().
+		std::shared_ptr<Packet::LogFrame> createFrame();
+		
 		void addFrame(std::shared_ptr<Packet::LogFrame> frame);
 		
 		// Gets frames.size() frames starting at <i> and working backwards.
@@ -89,44 +142,139 @@ class Logger
 		int getFrames(int start, std::vector<std::shared_ptr<Packet::LogFrame> > &frames) const;
 		
 		// Returns the amount of memory used by all LogFrames in the history.
+		// This is calculated by the writer thread so it may lag slightly behind,
+		// except for frames dropped from the queue which are counted by addFrame().
 		int spaceUsed() const
 		{
-			QMutexLocker locker(&_mutex);
 			return _spaceUsed;
 		}
 		
 		bool recording() const
 		{
-			QMutexLocker locker(&_mutex);
+			QMutexLocker locker(&_fileMutex);
 			return _fd >= 0;
 		}
 		
 		QString filename() const
 		{
-			QMutexLocker locker(&_mutex);
+			QMutexLocker locker(&_fileMutex);
 			return _filename;
 		}
 		
+		DropPolicy dropPolicy() const
+		{
+			return _dropPolicy;
+		}
+		
+		void dropPolicy(DropPolicy value)
+		{
+			_dropPolicy = value;
+		}
+		
+		WriterStats writerStats() const;
+		
 	private:
-		mutable QMutex _mutex;
+		/// Maximum number of frames waiting to be written (about 17 seconds at 60 Hz)
+		static const size_t QueueSize = 1024;
+		
+		/// Maximum number of recycled frames to keep for createFrame(),
+		/// and of removed frames to wait for
+		static const size_t FreeFrames = 8;
+		
+		/// Frames queued for the writer thread along with their sequence numbers
+		struct QueuedFrame
+		{
+			QueuedFrame()
+			{
+				sequence = 0;
+			}
+			
+			int sequence;
+			std::shared_ptr<Packet::LogFrame> frame;
+		};
+		
+		class WriterThread: public QThread
+		{
+		public:
+			WriterThread(Logger *logger)
+			{
+				_logger = logger;
+			}
+			
+		protected:
+			virtual void run()
+			{
+				_logger->writerLoop();
+			}
+			
+			Logger *_logger;
+		};
+		
+		void writerLoop();
+		
+		/// Drains the queue and writes everything to the file.
+		/// Must be called with _fileMutex locked.
+		void flushQueue();
+		
+		/// Updates _spaceUsed for @frame being stored in _history[i]
+		void accountSpace(int i, const Packet::LogFrame &frame);
+		
+		/// Closes the file.  Must be called with _fileMutex locked.
+		void closeFile();
+		
+		/// Protects the file and the consumer side of _queue
+		mutable QMutex _fileMutex;
 		
 		QString _filename;
 		
 		/**
 		 * Frame history.
 		 * Increasing indices correspond to earlier times.
-		 * This must only be accessed while _mutex is locked.
 		 *
-		 * It is not safe to modify a single std::shared_ptr from multiple threads,
-		 * but after it is copied the copies can be used and destroyed freely in different threads.
+		 * Readers in other threads never block addFrame(): each slot is only read and written
+		 * with std::atomic_load/std::atomic_store, and _nextFrameNumber is incremented after
+		 * the slot is stored.  A reader asking for a frame that is just about to fall out of the
+		 * buffer may get its replacement instead, which only matters for frames about
+		 * _history.size() old.
+		 *
+		 * After a shared_ptr is copied out of a slot the copy can be used and destroyed freely
+		 * in any thread.
 		 */
 		std::vector<std::shared_ptr<Packet::LogFrame> > _history;
 		
+		/// Frames removed from the history that nobody else references.
+		/// This is only used by the thread that calls addFrame().
+		std::vector<std::shared_ptr<Packet::LogFrame> > _freeFrames;
+		
+		/// Frames removed from the history that were still referenced by the writer
+		/// thread or a reader.  createFrame() moves them to _freeFrames once they are released.
+		/// This is only used by the thread that calls addFrame().
+		std::vector<std::shared_ptr<Packet::LogFrame> > _retiredFrames;
+		
 		// Sequence number of the next frame to be written
-		int _nextFrameNumber;
+		std::atomic<int> _nextFrameNumber;
 		
-		int _spaceUsed;
+		// Space used by the history, updated by the writer thread
+		// (or by addFrame() for frames that were dropped from the queue).
+		// _frameSpace[i] is the space counted for the frame in _history[i].
+		std::atomic<int> _spaceUsed;
+		std::vector<int> _frameSpace;
 		
 		// File descriptor for log file
 		int _fd;
+		
+		SpscQueue<QueuedFrame, QueueSize> _queue;
+		std::atomic<DropPolicy> _dropPolicy;
+		
+		// Serialized frames waiting to be written.
+		// This keeps its capacity so the writer thread doesn't allocate in steady state.
+		std::string _buffer;
+		
+		std::atomic<int> _maxQueued;
+		std::atomic<int> _dropped;
+		std::atomic<int> _framesWritten;
+		std::atomic<uint64_t> _bytesWritten;
+		
+		volatile bool _running;
+		WriterThread _writer;
 };
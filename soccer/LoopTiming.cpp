@@ -0,0 +1,77 @@
+#include "LoopTiming.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+using namespace std;
+using namespace Packet;
+
+// Names and LoopTiming fields in the order of LoopTimingStats::Stage
+static const struct
+{
+	const char *name;
+	uint32_t (LoopTiming::*field)() const;
+} Stages[LoopTimingStats::NumStages] =
+{
+	{"Vision",		&LoopTiming::vision},
+	{"Models",		&LoopTiming::models},
+	{"Referee",		&LoopTiming::referee},
+	{"Python",		&LoopTiming::gameplay_python},
+	{"Planning",	&LoopTiming::gameplay_planning},
+	{"Motion",		&LoopTiming::motion_control},
+	{"Radio",		&LoopTiming::radio},
+	{"Logger",		&LoopTiming::logger},
+	{"Total",		&LoopTiming::total}
+};
+
+LoopTimingStats::LoopTimingStats()
+{
+	memset(_samples, 0, sizeof(_samples));
+	_next = 0;
+	_count = 0;
+}
+
+const char *LoopTimingStats::name(Stage stage)
+{
+	return Stages[stage].name;
+}
+
+void LoopTimingStats::add(const LoopTiming &timing)
+{
+	for (int i = 0; i < NumStages; ++i)
+	{
+		_samples[i][_next] = (timing.*Stages[i].field)();
+	}
+
+	_next = (_next + 1) % Window;
+	_count = min(_count + 1, (int)Window);
+}
+
+void LoopTimingStats::summarize(Summary *summaries)
+{
+	for (int i = 0; i < NumStages; ++i)
+	{
+		Summary &s = summaries[i];
+		if (_count == 0)
+		{
+			s = Summary();
+			continue;
+		}
+
+		// The samples are in a ring buffer, but order doesn't matter for percentiles
+		// as long as we only look at the valid ones.
+		uint32_t *end = _sorted + _count;
+		copy(_samples[i], _samples[i] + _count, _sorted);
+
+		uint32_t *p50 = _sorted + _count / 2;
+		nth_element(_sorted, p50, end);
+		s.p50 = *p50;
+
+		// nth_element leaves everything above p50 in the upper part
+		uint32_t *p99 = _sorted + (_count * 99) / 100;
+		nth_element(p50, p99, end);
+		s.p99 = *p99;
+
+		s.max = *max_element(p99, end);
+	}
+}
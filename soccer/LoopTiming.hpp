@@ -0,0 +1,117 @@
+#pragma once
+
+#include <Utils.hpp>
+#include <protobuf/LogFrame.pb.h>
+
+#include <stdint.h>
+
+/**
+ * @brief Measures how long one stage of the processing loop takes.
+ *
+ * @details This uses the monotonic clock and never allocates, so it is cheap
+ * enough to wrap every stage of every frame.  Durations are in microseconds.
+ *
+ * Example:
+ *		SpanTimer span;
+ *		runModels();
+ *		timing->set_models(span.lap());
+ *		_gameplayModule->run();
+ *		...
+ */
+class SpanTimer
+{
+public:
+	SpanTimer()
+	{
+		restart();
+	}
+
+	void restart()
+	{
+		_start = monotonicTimestamp();
+	}
+
+	/// Microseconds since construction or the last restart() or lap()
+	uint32_t elapsed() const
+	{
+		return monotonicTimestamp() - _start;
+	}
+
+	/// Returns elapsed() and starts timing the next span
+	uint32_t lap()
+	{
+		Time now = monotonicTimestamp();
+		uint32_t span = now - _start;
+		_start = now;
+		return span;
+	}
+
+private:
+	Time _start;
+};
+
+/**
+ * @brief Rolling latency statistics for each stage of the processing loop
+ *
+ * @details The Processor adds the Packet::LoopTiming from each LogFrame.
+ * The most recent Window samples of each stage are kept in fixed-size ring buffers
+ * and summarized on request, so adding a frame is just a few stores.
+ */
+class LoopTimingStats
+{
+public:
+	/// Number of frames to keep (ten seconds at 60 Hz)
+	static const int Window = 600;
+
+	enum Stage
+	{
+		Vision,
+		Models,
+		Referee,
+		GameplayPython,
+		GameplayPlanning,
+		MotionControl,
+		Radio,
+		Logger,
+		Total,
+		NumStages
+	};
+
+	/// Latencies in microseconds over the window
+	struct Summary
+	{
+		Summary()
+		{
+			p50 = 0;
+			p99 = 0;
+			max = 0;
+		}
+
+		uint32_t p50;
+		uint32_t p99;
+		uint32_t max;
+	};
+
+	LoopTimingStats();
+
+	/// Human-readable name of a stage
+	static const char *name(Stage stage);
+
+	void add(const Packet::LoopTiming &timing);
+
+	/// Computes p50/p99/max for each stage over the current window.
+	/// @summaries must have NumStages entries.
+	void summarize(Summary *summaries);
+
+private:
+	uint32_t _samples[NumStages][Window];
+
+	/// Scratch space for partial sorting in summarize()
+	uint32_t _sorted[Window];
+
+	/// Index in _samples where the next frame will be stored
+	int _next;
+
+	/// Number of valid samples (at most Window)
+	int _count;
+};
@@ -88,6 +88,12 @@ MainWindow::MainWindow(QWidget *parent):
 	calcMinimumWidth(_procFPS, "Proc: 00.0 fps");
 	statusBar()->addPermanentWidget(_procFPS);
 	
+	_loopLatency = new QLabel();
+	_loopLatency->setFrameStyle(QFrame::StyledPanel | QFrame::Sunken);
+	_loopLatency->setToolTip("Processing Loop Latency");
+	calcMinimumWidth(_loopLatency, "Loop: 00.0/00.0/00.0 ms");
+	statusBar()->addPermanentWidget(_loopLatency);
+	
 	_logMemory = new QLabel();
 	_logMemory->setFrameStyle(QFrame::StyledPanel | QFrame::Sunken);
 	_logMemory->setToolTip("Log Memory Usage");
@@ -185,15 +191,18 @@ void MainWindow::live(bool value)
 
 void MainWindow::updateViews()
 {
-	int manual =_processor->manualID();
-	if ((manual >= 0 || _ui.manualID->isEnabled()) && !_processor->joystickValid())
+	// Everything we need from the processing thread, without locking it
+	std::shared_ptr<const Processor::Snapshot> snapshot = _processor->snapshot();
+	
+	int manual = snapshot->manualID;
+	if ((manual >= 0 || _ui.manualID->isEnabled()) && !snapshot->joystickValid)
 	{
 		// Joystick is gone - turn off manual control
 		_ui.manualID->setCurrentIndex(0);
 		_processor->manualID(-1);
 		_ui.manualID->setEnabled(false);
 		_ui.tabWidget->setTabEnabled(2, false);
-	} else if (!_ui.manualID->isEnabled() && _processor->joystickValid())
+	} else if (!_ui.manualID->isEnabled() && snapshot->joystickValid)
 	{
 		// Joystick reconnected
 		_ui.manualID->setEnabled(true);
@@ -201,7 +210,7 @@ void MainWindow::updateViews()
 		_ui.tabWidget->setTabEnabled(2, true);
 	}
 	if(manual >= 0) {
-		JoystickControlValues vals = _processor->getJoystickControlValues();
+		const JoystickControlValues &vals = snapshot->joystickControlValues;
 		_ui.joystickBodyXLabel->setText(tr("%1").arg(vals.translation.x));
 		_ui.joystickBodyYLabel->setText(tr("%1").arg(vals.translation.y));
 		_ui.joystickBodyWLabel->setText(tr("%1").arg(vals.rotation));
@@ -224,13 +233,55 @@ void MainWindow::updateViews()
 		_updateCount = 0;
 		
 		_viewFPS->setText(QString("View: %1 fps").arg(framerate, 0, 'f', 1));
-		_procFPS->setText(QString("Proc: %1 fps").arg(_processor->framerate(), 0, 'f', 1));
+		_procFPS->setText(QString("Proc: %1 fps").arg(snapshot->framerate, 0, 'f', 1));
+		
+		QString visionTip = "Processing Framerate";
+		for (int i = 0; i < VisionClock::MaxCameras; ++i)
+		{
+			if (snapshot->status.visionLatency[i] > 0)
+			{
+				visionTip += QString("\nCamera %1 latency: %2 ms").arg(
+					QString::number(i),
+					QString::number(snapshot->status.visionLatency[i] * 1000, 'f', 1));
+			}
+		}
+		_procFPS->setToolTip(visionTip);
+		
+		// Show p50/p99/max of the whole loop, with each stage in the tooltip
+		const Processor::Status &ps = snapshot->status;
+		const LoopTimingStats::Summary &total = ps.timing[LoopTimingStats::Total];
+		_loopLatency->setText(QString("Loop: %1/%2/%3 ms").arg(
+			QString::number(total.p50 / 1000.0, 'f', 1),
+			QString::number(total.p99 / 1000.0, 'f', 1),
+			QString::number(total.max / 1000.0, 'f', 1)
+		));
+		
+		QString tip = "Processing loop latency (p50/p99/max ms)";
+		for (int i = 0; i < LoopTimingStats::NumStages; ++i)
+		{
+			const LoopTimingStats::Summary &s = ps.timing[i];
+			tip += QString("\n%1: %2/%3/%4").arg(
+				LoopTimingStats::name((LoopTimingStats::Stage)i),
+				QString::number(s.p50 / 1000.0, 'f', 2),
+				QString::number(s.p99 / 1000.0, 'f', 2),
+				QString::number(s.max / 1000.0, 'f', 2));
+		}
+		_loopLatency->setToolTip(tip);
 		
 		_logMemory->setText(QString("Log: %1/%2 %3 kiB").arg(
 			QString::number(_processor->logger().numFrames()),
 			QString::number(_processor->logger().maxFrames()),
 			QString::number((_processor->logger().spaceUsed() + 512) / 1024)
 		));
+		
+		Logger::WriterStats ws = _processor->logger().writerStats();
+		_logMemory->setToolTip(QString("Log Memory Usage\nWriter queue: %1 (max %2)\nDropped: %3\nWritten: %4 frames, %5 kiB").arg(
+			QString::number(ws.queued),
+			QString::number(ws.maxQueued),
+			QString::number(ws.dropped),
+			QString::number(ws.framesWritten),
+			QString::number((ws.bytesWritten + 512) / 1024)
+		));
 	}
 	
 	// Advance log playback time
@@ -424,7 +475,9 @@ void MainWindow::updateStatus()
 		return;
 	}
 	
-	if (_processor->manualID() >= 0)
+	// The processor only sees a new manual ID on its next cycle, so use the one
+	// the GUI last set instead of the snapshot.
+	if (_ui.manualID->currentIndex() > 0)
 	{
 		// Mixed auto/manual control
 		status("MANUAL", Status_Warning);
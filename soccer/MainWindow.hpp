@@ -200,5 +200,6 @@ class MainWindow : public QMainWindow
 		QLabel *_logFile;
 		QLabel *_viewFPS;
 		QLabel *_procFPS;
+		QLabel *_loopLatency;
 		QLabel *_logMemory;
 };
@@ -0,0 +1,58 @@
+#include "ObstacleCache.hpp"
+
+#include <SystemState.hpp>
+#include <Robot.hpp>
+
+using namespace Geometry2d;
+
+ObstacleCache::ObstacleCache()
+{
+	for (int i = 0; i < Num_Shells; ++i)
+	{
+		_self[i].visible = false;
+		_opp[i].visible = false;
+	}
+	_ballValid = false;
+}
+
+void ObstacleCache::clearStatic()
+{
+	_static.clear();
+}
+
+void ObstacleCache::addStatic(const std::shared_ptr<Shape> &shape, const Planning::DistanceField *field, bool goalie)
+{
+	StaticEntry entry;
+	entry.shape = shape;
+	entry.field = field;
+	entry.goalie = goalie;
+	_static.push_back(entry);
+}
+
+void ObstacleCache::addStatic(Planning::ObstacleWorld &world, bool goalie) const
+{
+	for (const StaticEntry &entry : _static)
+	{
+		if (!goalie || entry.goalie)
+		{
+			world.add(entry.shape.get(), entry.field);
+		}
+	}
+}
+
+void ObstacleCache::update(const SystemState *state)
+{
+	for (int i = 0; i < Num_Shells; ++i)
+	{
+		const OurRobot *r = state->self[i];
+		_self[i].visible = r && r->visible;
+		_self[i].pos = r ? r->pos : Point();
+		
+		const OpponentRobot *opp = state->opp[i];
+		_opp[i].visible = opp && opp->visible;
+		_opp[i].pos = opp ? opp->pos : Point();
+	}
+	
+	_ballValid = state->ball.valid;
+	_ballPos = state->ball.pos;
+}
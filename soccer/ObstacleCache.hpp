@@ -0,0 +1,87 @@
+#pragma once
+
+#include <Constants.hpp>
+#include <Geometry2d/CompositeShape.hpp>
+#include <Geometry2d/Point.hpp>
+#include <planning/ObstacleWorld.hpp>
+
+#include <vector>
+
+class SystemState;
+
+/**
+ * @brief Obstacles shared by every robot's path planning in one frame
+ *
+ * @details
+ * GameplayModule updates this once per frame, before any robot plans.  It holds
+ * each robot and the ball once, as positions rather than Shapes, and the field
+ * obstacles that apply this frame along with their distance fields.
+ *
+ * Each robot builds its planning query from this (see OurRobot::replanIfNeeded())
+ * by choosing which robots to avoid and by how much, so nothing here is copied
+ * and no per-robot Shapes are allocated.
+ *
+ * This is read concurrently by the planning tasks, so it must not change while they run.
+ */
+class ObstacleCache
+{
+public:
+	struct RobotEntry
+	{
+		Geometry2d::Point pos;
+		bool visible;
+	};
+
+	ObstacleCache();
+
+	/// Takes robot and ball positions from @state
+	void update(const SystemState *state);
+
+	/// Removes all field obstacles
+	void clearStatic();
+
+	/// Adds a field obstacle.  @field, if given, must cover @shape and outlive this frame's planning.
+	/// If @goalie is false, the goalie doesn't avoid this.
+	void addStatic(const std::shared_ptr<Geometry2d::Shape> &shape, const Planning::DistanceField *field, bool goalie = true);
+
+	/// Adds the field obstacles that apply to a robot to @world.
+	/// Each one gets its own ShapeSet index.
+	void addStatic(Planning::ObstacleWorld &world, bool goalie) const;
+
+	/// Our robots and theirs, by shell
+	const RobotEntry &self(int shell) const
+	{
+		return _self[shell];
+	}
+
+	const RobotEntry &opp(int shell) const
+	{
+		return _opp[shell];
+	}
+
+	bool ballValid() const
+	{
+		return _ballValid;
+	}
+
+	Geometry2d::Point ballPos() const
+	{
+		return _ballPos;
+	}
+
+private:
+	struct StaticEntry
+	{
+		std::shared_ptr<Geometry2d::Shape> shape;
+		const Planning::DistanceField *field;
+		bool goalie;
+	};
+
+	std::vector<StaticEntry> _static;
+
+	RobotEntry _self[Num_Shells];
+	RobotEntry _opp[Num_Shells];
+
+	bool _ballValid;
+	Geometry2d::Point _ballPos;
+};
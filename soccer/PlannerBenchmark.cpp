@@ -0,0 +1,343 @@
+// Measures path planning on canned scenes, outside of a live run.
+//
+// Each scene is planned many times with fixed seeds, so results can be compared
+// between builds to check speedups and catch regressions.
+//
+// usage: planner-benchmark [runs per scene] [seed]
+
+#include <Configuration.hpp>
+#include <Constants.hpp>
+#include <planning/RRTPlanner.hpp>
+#include <planning/ObstacleWorld.hpp>
+#include <Geometry2d/Circle.hpp>
+#include <Geometry2d/Polygon.hpp>
+#include <time.hpp>
+#include <AllocationCounter.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+using namespace std;
+using namespace Geometry2d;
+using namespace Planning;
+
+//// Scenes ////
+
+struct Scene
+{
+	const char *name;
+	Point start;
+	Point goal;
+	CompositeShape obstacles;
+};
+
+static void addRobot(Scene &scene, const Point &pos)
+{
+	scene.obstacles.add(std::make_shared<Circle>(pos, Robot_Radius));
+}
+
+static void addRect(CompositeShape &obstacles, float x1, float y1, float x2, float y2)
+{
+	std::shared_ptr<Polygon> poly = std::make_shared<Polygon>();
+	poly->vertices.push_back(Point(x1, y1));
+	poly->vertices.push_back(Point(x2, y1));
+	poly->vertices.push_back(Point(x2, y2));
+	poly->vertices.push_back(Point(x1, y2));
+	obstacles.add(poly);
+}
+
+// Outside of the floor, as in GameplayModule
+static void addField(Scene &scene)
+{
+	const Field_Dimensions &dims = Field_Dimensions::Current_Dimensions;
+	const float x = dims.FloorWidth() / 2;
+	const float y = dims.Length() + dims.Border();
+	const float deadspace = dims.Border();
+	addRect(scene.obstacles, -x, -deadspace, x, -deadspace - 1);
+	addRect(scene.obstacles, -x, y, x, y + 1);
+	addRect(scene.obstacles, -x, -deadspace, -x - 1, dims.FloorLength());
+	addRect(scene.obstacles, x, -deadspace, x + 1, dims.FloorLength());
+}
+
+// Our goal area, as in GameplayModule
+static void addGoalArea(Scene &scene)
+{
+	const Field_Dimensions &dims = Field_Dimensions::Current_Dimensions;
+	const float halfFlat = dims.GoalFlat() / 2;
+	const float radius = dims.ArcRadius();
+	addRect(scene.obstacles, -halfFlat, 0, halfFlat, radius);
+	scene.obstacles.add(std::make_shared<Circle>(Point(-halfFlat, 0), radius));
+	scene.obstacles.add(std::make_shared<Circle>(Point(halfFlat, 0), radius));
+}
+
+static void makeScenes(vector<Scene> &scenes)
+{
+	const Field_Dimensions &dims = Field_Dimensions::Current_Dimensions;
+	const float length = dims.Length();
+	const float width = dims.Width();
+
+	// Fixed, so every build sees the same scenes
+	srand48(1);
+
+	scenes.resize(4);
+
+	Scene &open = scenes[0];
+	open.name = "open field";
+	open.start = Point(-width / 4, 0.5);
+	open.goal = Point(width / 4, length - 0.5);
+	addField(open);
+	addGoalArea(open);
+
+	// Staggered rows of robots across the middle of the field, between the start and goal
+	Scene &midfield = scenes[1];
+	midfield.name = "dense midfield";
+	midfield.start = Point(0, length / 4);
+	midfield.goal = Point(0, length * 3 / 4);
+	addField(midfield);
+	addGoalArea(midfield);
+	for (int row = 0; row < 3; ++row)
+	{
+		for (int col = 0; col < 6; ++col)
+		{
+			float offset = (row % 2) ? 0 : 0.5f;
+			Point pos((col - 2.5f + offset) * width / 7, length / 2 + (row - 1) * 0.4f);
+			pos += Point(drand48() - 0.5, drand48() - 0.5) * 0.1f;
+			addRobot(midfield, pos);
+		}
+	}
+
+	// Robots packed around the goal area, going across the front of it
+	Scene &scrum = scenes[2];
+	scrum.name = "goal-mouth scrum";
+	scrum.start = Point(-width / 2 + 0.3, 0.4);
+	scrum.goal = Point(width / 2 - 0.3, 0.4);
+	addField(scrum);
+	addGoalArea(scrum);
+	const float arc = dims.ArcRadius() + Robot_Radius * 3;
+	for (int i = 0; i < 10; ++i)
+	{
+		float angle = M_PI * (i + 0.5f) / 10;
+		float r = arc + (i % 2) * Robot_Radius * 2.5f;
+		addRobot(scrum, Point(cosf(angle) * (r + dims.GoalFlat() / 2), sinf(angle) * r));
+	}
+
+	// The robot is touching another one when it starts
+	Scene &inside = scenes[3];
+	inside.name = "start in obstacle";
+	inside.start = Point(0, length / 2);
+	inside.goal = Point(width / 4, length / 4);
+	addField(inside);
+	addGoalArea(inside);
+	addRobot(inside, inside.start + Point(Robot_Radius, 0));
+	addRobot(inside, inside.start + Point(-Robot_Radius * 2, Robot_Radius * 2));
+	addRobot(inside, Point(width / 8, length * 3 / 8));
+}
+
+//// Benchmarks ////
+
+// Time and allocations for a number of operations
+class Measure
+{
+	public:
+		Measure():
+			_ops(0),
+			_time(0),
+			_allocations(0)
+		{
+		}
+
+		void start()
+		{
+			_startAllocations = allocationCount();
+			_startTime = monotonicTimestamp();
+		}
+
+		void stop(int ops = 1)
+		{
+			_time += monotonicTimestamp() - _startTime;
+			_allocations += allocationCount() - _startAllocations;
+			_ops += ops;
+		}
+
+		double nsPerOp() const
+		{
+			return _ops ? (double)_time * 1000 / _ops : 0;
+		}
+
+		double allocationsPerOp() const
+		{
+			return _ops ? (double)_allocations / _ops : 0;
+		}
+
+	private:
+		long _ops;
+		Time _time;
+		unsigned long _allocations;
+		Time _startTime;
+		unsigned long _startAllocations;
+};
+
+static void benchmarkScene(const Scene &scene, int runs, long seed)
+{
+	ObstacleWorld world(scene.obstacles);
+
+	MotionConstraints mc;
+	mc.targetPos = scene.goal;
+
+	Measure plan, pathHit;
+	int successes = 0;
+	double totalLength = 0;
+	long totalIterations = 0;
+
+	for (int i = 0; i < runs; ++i)
+	{
+		// A new planner each time so no run depends on the ones before it
+		srand48(seed + i);
+		RRTPlanner planner;
+
+		Path path;
+		plan.start();
+		planner.run(scene.start, 0, Point(), mc, &world, path);
+		plan.stop();
+
+		totalIterations += planner.iterations();
+
+		bool hit = false;
+		const int hitRepeats = 100;
+		pathHit.start();
+		for (int j = 0; j < hitRepeats; ++j)
+		{
+			hit = path.hit(world);
+		}
+		pathHit.stop(hitRepeats);
+
+		if (path.valid() && !hit && path.points.back().nearPoint(scene.goal, 0.05))
+		{
+			++successes;
+			totalLength += path.length();
+		}
+	}
+
+	// Collision tests on random segments, as the planner does them
+	const int numSegments = 10000;
+	vector<Segment> segments;
+	segments.reserve(numSegments);
+	unsigned short randomState[3] = {1, 2, (unsigned short)seed};
+	for (int i = 0; i < numSegments; ++i)
+	{
+		Point p = randomPoint(randomState);
+		Point d(erand48(randomState) - 0.5, erand48(randomState) - 0.5);
+		segments.push_back(Segment(p, p + d * 0.3f));
+	}
+
+	int compositeHits = 0, worldHits = 0;
+	Measure compositeHit;
+	compositeHit.start();
+	for (const Segment &seg : segments)
+	{
+		compositeHits += scene.obstacles.hit(seg);
+	}
+	compositeHit.stop(numSegments);
+
+	Measure worldHit;
+	worldHit.start();
+	for (const Segment &seg : segments)
+	{
+		worldHits += world.hit(seg);
+	}
+	worldHit.stop(numSegments);
+
+	if (compositeHits != worldHits)
+	{
+		printf("  ObstacleWorld disagrees with CompositeShape: %d and %d hits\n", worldHits, compositeHits);
+	}
+
+	printf("%s (%d obstacles)\n", scene.name, (int)scene.obstacles.size());
+	printf("  RRTPlanner::run       %10.0f ns/op %8.1f allocs/op\n", plan.nsPerOp(), plan.allocationsPerOp());
+	printf("    success %5.1f%%   path length %6.3f m   iterations %6.1f\n",
+			successes * 100.0 / runs, successes ? totalLength / successes : 0.0, (double)totalIterations / runs);
+	printf("  Path::hit             %10.0f ns/op %8.1f allocs/op\n", pathHit.nsPerOp(), pathHit.allocationsPerOp());
+	printf("  CompositeShape::hit   %10.0f ns/op %8.1f allocs/op\n", compositeHit.nsPerOp(), compositeHit.allocationsPerOp());
+	printf("  ObstacleWorld::hit    %10.0f ns/op %8.1f allocs/op\n", worldHit.nsPerOp(), worldHit.allocationsPerOp());
+}
+
+// The smoothing solve on its own, for paths of a few lengths
+static void benchmarkBezier(int runs)
+{
+	printf("cubicBezier\n");
+
+	vector<Point> points, controls;
+	vector<double> ks, ks2;
+	for (int n = 3; n <= 24; n *= 2)
+	{
+		points.clear();
+		ks.clear();
+		ks2.clear();
+		for (int i = 0; i < n; ++i)
+		{
+			points.push_back(Point(sinf(i) * 0.5f, i * 0.3f));
+		}
+		for (int i = 0; i < n - 1; ++i)
+		{
+			// As in RRTPlanner::cubicBezier(), one over the time for each curve
+			double k = 1.0 / max(0.01f, points[i].distTo(points[i + 1]));
+			ks.push_back(k);
+			ks2.push_back(k * k);
+		}
+
+		// Once first so the scratch storage has grown
+		RRTPlanner::cubicBezierCalc(Point(), Point(), points, ks, ks2, controls);
+
+		Measure bezier;
+		bezier.start();
+		for (int i = 0; i < runs * 10; ++i)
+		{
+			RRTPlanner::cubicBezierCalc(Point(), Point(), points, ks, ks2, controls);
+		}
+		bezier.stop(runs * 10);
+
+		printf("  %2d points            %10.0f ns/op %8.1f allocs/op\n", n, bezier.nsPerOp(), bezier.allocationsPerOp());
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int runs = 200;
+	long seed = 1;
+	if (argc > 1)
+	{
+		runs = atoi(argv[1]);
+	}
+	if (argc > 2)
+	{
+		seed = atol(argv[2]);
+	}
+	if (runs <= 0)
+	{
+		printf("usage: %s [runs per scene] [seed]\n", argv[0]);
+		return 1;
+	}
+
+	// Default settings for everything, as if there were no config file
+	Configuration config;
+	for (Configurable *obj :  Configurable::configurables())
+	{
+		obj->createConfiguration(&config);
+	}
+
+	vector<Scene> scenes;
+	makeScenes(scenes);
+
+	printf("%d runs per scene, seed %ld\n\n", runs, seed);
+	for (const Scene &scene : scenes)
+	{
+		benchmarkScene(scene, runs, seed);
+		printf("\n");
+	}
+
+	benchmarkBezier(runs);
+
+	return 0;
+}
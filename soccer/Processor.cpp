@@ -35,11 +35,15 @@ using namespace boost;
 using namespace Geometry2d;
 using namespace google::protobuf;
 
-static const uint64_t Command_Latency = 0;
-
 RobotConfig *Processor::robotConfig2008;
 RobotConfig *Processor::robotConfig2011;
 std::vector<RobotStatus*> Processor::robotStatuses; ///< FIXME: verify that this is correct
+ConfigBool *Processor::_visionTriggered;
+ConfigInt *Processor::_visionCameras;
+ConfigBool *Processor::_logVisionBytes;
+ConfigBool *Processor::_commandPrediction;
+ConfigInt *Processor::_defaultCommandLatency;
+ConfigBool *Processor::_imuFusion;
 
 
 //	Joystick speed limits (for damped and non-damped mode)
@@ -60,6 +64,13 @@ void Processor::createConfiguration(Configuration *cfg)
 	{
 		robotStatuses.push_back(new RobotStatus(cfg, QString("Robot Statuses/Robot %1").arg(s)));
 	}
+
+	_visionTriggered = new ConfigBool(cfg, "Processor/Vision Triggered", false);
+	_visionCameras = new ConfigInt(cfg, "Processor/Vision Cameras", 1);
+	_logVisionBytes = new ConfigBool(cfg, "Processor/Log Vision Bytes", false);
+	_commandPrediction = new ConfigBool(cfg, "Processor/Command Prediction", true);
+	_defaultCommandLatency = new ConfigInt(cfg, "Processor/Default Command Latency", 0);
+	_imuFusion = new ConfigBool(cfg, "Processor/IMU Fusion", true);
 }
 
 Processor::Processor(bool sim) : _loopMutex(QMutex::Recursive)
@@ -73,6 +84,8 @@ Processor::Processor(bool sim) : _loopMutex(QMutex::Recursive)
 	firstLogTime = 0;
 	_useOurHalf = true;
 	_useOpponentHalf = true;
+	_blueTeam = false;
+	_snapshot = std::make_shared<Snapshot>();
 
 	_simulation = sim;
 	_radio = 0;
@@ -117,38 +130,81 @@ void Processor::stop()
 	}
 }
 
-void Processor::manualID(int value)
+void Processor::post(const std::function<void()> &command)
 {
-	QMutexLocker locker(&_loopMutex);
-	_manualID = value;
+	if (!isRunning())
+	{
+		// Nothing else is using our state yet
+		command();
+		return;
+	}
+	
+	QMutexLocker locker(&_commandMutex);
+	_commands.push_back(command);
+}
 
+void Processor::runCommands()
+{
+	_commandMutex.lock();
+	_commands.swap(_runningCommands);
+	_commandMutex.unlock();
+	
+	for (const std::function<void()> &command : _runningCommands)
+	{
+		command();
+	}
+	_runningCommands.clear();
+}
+
+void Processor::publishSnapshot(const Status &status)
+{
+	std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+	snapshot->status = status;
+	snapshot->framerate = _framerate;
+	snapshot->manualID = _manualID;
+	snapshot->goalieID = _gameplayModule->goalieID();
+	
 	for (Joystick *joy : _joysticks) {
-		joy->reset();
+		if (joy->valid()) snapshot->joystickValid = true;
 	}
+	if (snapshot->joystickValid)
+	{
+		snapshot->joystickControlValues = getJoystickControlValues();
+	}
+	
+	std::atomic_store(&_snapshot, std::shared_ptr<const Snapshot>(snapshot));
 }
 
-void Processor::goalieID(int value)
+void Processor::manualID(int value)
 {
-	QMutexLocker locker(&_loopMutex);
-	_gameplayModule->goalieID(value);
+	post([this, value]() {
+		_manualID = value;
+
+		for (Joystick *joy : _joysticks) {
+			joy->reset();
+		}
+	});
 }
 
-int Processor::goalieID()
+void Processor::goalieID(int value)
 {
-	QMutexLocker locker(&_loopMutex);
-	return _gameplayModule->goalieID();
+	post([this, value]() {
+		_gameplayModule->goalieID(value);
+	});
 }
 
 void Processor::dampedRotation(bool value)
 {
-	QMutexLocker locker(&_loopMutex);
-	_dampedRotation = value;
+	post([this, value]() {
+		_dampedRotation = value;
+	});
 }
 
 void Processor::dampedTranslation(bool value)
 {
-	QMutexLocker locker(&_loopMutex);
-	_dampedTranslation = value;
+	post([this, value]() {
+		_dampedTranslation = value;
+	});
 }
 
 /**
@@ -158,24 +214,15 @@ void Processor::dampedTranslation(bool value)
 void Processor::blueTeam(bool value)
 {
 	// This is called from the GUI thread
-    QMutexLocker locker(&_loopMutex);
-
-    if(_blueTeam != value)
-    {
-        _blueTeam = value;
-        if(_radio)
-            _radio->switchTeam(_blueTeam);
-        //_refereeModule->blueTeam(value);
-    }
-}
-
-bool Processor::joystickValid()
-{
-	QMutexLocker lock(&_loopMutex);
-	for (Joystick *joy : _joysticks) {
-		if (joy->valid()) return true;
-	}
-	return false;
+	post([this, value]() {
+		if(_blueTeam != value)
+		{
+			_blueTeam = value;
+			if(_radio)
+				_radio->switchTeam(_blueTeam);
+			//_refereeModule->blueTeam(value);
+		}
+	});
 }
 
 void Processor::runModels(const vector<const SSL_DetectionFrame *> &detectionFrames)
@@ -203,7 +250,8 @@ void Processor::runModels(const vector<const SSL_DetectionFrame *> &detectionFra
 			unsigned int id = robot.robot_id();
 			if (id < _state.self.size())
 			{
-				_state.self[id]->filter()->update(&obs);
+				_robotFilter.observe(RobotFilter::index(id, true), obs);
+				_orientationFilter.vision(id, time, angleRad);
 			}
 		}
 		
@@ -216,21 +264,51 @@ void Processor::runModels(const vector<const SSL_DetectionFrame *> &detectionFra
 			unsigned int id = robot.robot_id();
 			if (id < _state.opp.size())
 			{
-				_state.opp[id]->filter()->update(&obs);
+				_robotFilter.observe(RobotFilter::index(id, false), obs);
 			}
 		}
+		
+		// All robots seen by this camera are updated together
+		_robotFilter.update();
 	}
 	
 	_ballTracker->run(ballObservations, &_state);
 	
-	for (Robot *robot : _state.self)
+	const Time commandTime = _state.logFrame->command_time();
+	const Time latency = commandLatency();
+	for (OurRobot *robot : _state.self)
 	{
-		robot->filter()->predict(_state.logFrame->command_time(), robot);
+		const int index = RobotFilter::index(robot->shell(), true);
+		_robotFilter.predict(commandTime, index, *robot);
+		
+		const Time seen = _robotFilter.lastObserved(index);
+		if (seen && robot->visible)
+		{
+			// Our state when last seen, followed forward with the commands we've sent since
+			RobotPose pose;
+			_robotFilter.predict(seen, index, pose);
+			_commandHistory.observe(robot->shell(), seen, pose);
+			
+			if (*_commandPrediction)
+			{
+				_commandHistory.predict(robot->shell(), seen, commandTime, latency, pose);
+				robot->pos = pose.pos;
+				robot->vel = pose.vel;
+				robot->angle = pose.angle;
+				robot->angleVel = pose.angleVel;
+			}
+		}
+		
+		// The IMU is more recent than vision, so it has the last word on angle
+		if (robot->visible && *_imuFusion)
+		{
+			_orientationFilter.predict(robot->shell(), commandTime, robot->angle, robot->angleVel);
+		}
 	}
 	
 	for (Robot *robot : _state.opp)
 	{
-		robot->filter()->predict(_state.logFrame->command_time(), robot);
+		_robotFilter.predict(_state.logFrame->command_time(), RobotFilter::index(robot->shell(), false), *robot);
 	}
 }
 
@@ -246,10 +324,23 @@ void Processor::run()
 	
 	Status curStatus;
 	
+	// Absolute monotonic time at which the next cycle should start.
+	// Advancing this by exactly one period keeps overruns from drifting the schedule.
+	Time deadline = monotonicTimestamp();
+	
+	// Time taken to log the previous frame
+	uint32_t loggerTime = 0;
+	int frameCount = 0;
+	
+	// These keep their storage from one cycle to the next
+	vector<const SSL_DetectionFrame *> detectionFrames;
+	vector<VisionPacket *> visionPackets;
+	
 	bool first = true;
 	//main loop
 	while (_running)
 	{
+		SpanTimer frameSpan;
 		Time startTime = timestamp();
 		int delta_us = startTime - curStatus.lastLoopTime;
 		_framerate = 1000000.0 / delta_us;
@@ -261,19 +352,25 @@ void Processor::run()
 			firstLogTime = startTime;
 		}
 		
+		// Apply changes requested by other threads
+		runCommands();
+		
 		////////////////
 		// Reset
 		
-		// Make a new log frame
-		_state.logFrame = std::make_shared<Packet::LogFrame>();
+		// Make a new log frame, recycling an old one's memory if possible
+		_state.logFrame = _logger.createFrame();
     _state.logFrame->set_timestamp(timestamp());
-		_state.logFrame->set_command_time(startTime + Command_Latency);
+		_state.logFrame->set_command_time(startTime + commandLatency());
 		_state.logFrame->set_use_our_half(_useOurHalf);
 		_state.logFrame->set_use_opponent_half(_useOpponentHalf);
 		_state.logFrame->set_manual_id(_manualID);
 		_state.logFrame->set_blue_team(_blueTeam);
 		_state.logFrame->set_defend_plus_x(_defendPlusX);
 		
+		Packet::LoopTiming *timing = _state.logFrame->mutable_timing();
+		timing->set_logger(loggerTime);
+		
 		if (first)
 		{
 			first = false;
@@ -309,23 +406,30 @@ void Processor::run()
 		// Inputs
 		
 		// Read vision packets
-		vector<const SSL_DetectionFrame *> detectionFrames;
-		vector<VisionPacket *> visionPackets;
+		SpanTimer span;
+		detectionFrames.clear();
 		vision.getPackets(visionPackets);
+		bool logVisionBytes = *_logVisionBytes;
 		for (VisionPacket *packet : visionPackets)
 		{
-			SSL_WrapperPacket *log = _state.logFrame->add_raw_vision();
-			log->CopyFrom(packet->wrapper);
+			if (logVisionBytes)
+			{
+				_state.logFrame->add_raw_vision_bytes(packet->data, packet->size);
+			} else {
+				_state.logFrame->add_raw_vision()->CopyFrom(packet->wrapper);
+			}
 			
 			curStatus.lastVisionTime = packet->receivedTime;
 			if (packet->wrapper.has_detection())
 			{
 				SSL_DetectionFrame *det = packet->wrapper.mutable_detection();
 				
-				//FIXME - Account for network latency
+				// Convert vision timestamps to our clock
 				double rt = packet->receivedTime / 1000000.0;
-				det->set_t_capture(rt - det->t_sent() + det->t_capture());
-				det->set_t_sent(rt);
+				double offset = _visionClock.update(det->camera_id(), rt, det->t_sent(), det->t_capture());
+				det->set_t_capture(det->t_capture() + offset);
+				det->set_t_sent(det->t_sent() + offset);
+				curStatus.visionLatency[det->camera_id() % VisionClock::MaxCameras] = _visionClock.latency(det->camera_id());
 				
 				// Remove balls on the excluded half of the field
 				google::protobuf::RepeatedPtrField<SSL_DetectionBall> *balls = det->mutable_balls();
@@ -367,6 +471,7 @@ void Processor::run()
 				detectionFrames.push_back(det);
 			}
 		}
+		timing->set_vision(span.lap());
 		
 		// Read radio reverse packets
 		_radio->receive();
@@ -384,6 +489,12 @@ void Processor::run()
 				// but LogFrame will not (the RadioRx in LogFrame will be reused).
 				_state.self[board]->radioRx().CopyFrom(rx);
 				_state.self[board]->radioRxUpdated();
+				
+				if (rx.has_quaternion())
+				{
+					const Packet::Quaternion &q = rx.quaternion();
+					_orientationFilter.imu(board, rx.timestamp(), OrientationFilter::yaw(q.q0(), q.q1(), q.q2(), q.q3()));
+				}
 			}
 		}
 		_radio->clear();
@@ -394,15 +505,18 @@ void Processor::run()
 			joystick->update();
 		}
 		
+		span.restart();
 		runModels(detectionFrames);
 		for (VisionPacket *packet : visionPackets)
 		{
-			delete packet;
+			vision.recycle(packet);
 		}
+		timing->set_models(span.lap());
 		
 		// Update gamestate w/ referee data
 		_refereeModule->updateGameState(blueTeam());
 		_refereeModule->spinKickWatcher();
+		timing->set_referee(span.lap());
 
 
 		string yellowname,bluename;
@@ -426,6 +540,7 @@ void Processor::run()
 		}
 
 		// Run velocity controllers
+		span.restart();
 		for (OurRobot *robot : _state.self)
 		{
 			if (robot->visible)
@@ -438,6 +553,7 @@ void Processor::run()
 				}	
 			}
 		}
+		timing->set_motion_control(span.lap());
 
 		////////////////
 		// Store logging information
@@ -531,38 +647,67 @@ void Processor::run()
 		// Outputs
 		
 		// Send motion commands to the robots
+		span.restart();
 		sendRadioData();
+		timing->set_radio(span.lap());
+		
+		timing->set_total(frameSpan.elapsed());
+		_timingStats.add(*timing);
 
 		// Write to the log
+		span.restart();
 		_logger.addFrame(_state.logFrame);
+		loggerTime = span.lap();
 		
 		_loopMutex.unlock();
 		
+		// Update latency statistics for the GUI a few times per second
+		if (++frameCount % 30 == 0)
+		{
+			_timingStats.summarize(curStatus.timing);
+		}
+		
 		// Store processing loop status
-		_statusMutex.lock();
-		_status = curStatus;
-		_statusMutex.unlock();
+		publishSnapshot(curStatus);
 		
 		////////////////
 		// Timing
 		
-		Time endTime = timestamp();
-		int lastFrameTime = endTime - startTime;
-		if (lastFrameTime < _framePeriod)
+		deadline += _framePeriod;
+		Time now = monotonicTimestamp();
+		if (now > deadline + _framePeriod)
+		{
+			// We fell more than a whole period behind.  Don't try to catch up
+			// by running several cycles back-to-back.
+			deadline = now;
+		}
+		
+		if (*_visionTriggered)
 		{
-			// Use system usleep, not QThread::usleep.
+			// Wake up as soon as fresh vision is available.  The deadline
+			// keeps the loop running if vision is lost.
+			if (vision.waitForFrames(deadline, *_visionCameras))
+			{
+				deadline = monotonicTimestamp();
+			}
+		} else {
+			// Use clock_nanosleep, not QThread::usleep.
 			//
 			// QThread::usleep uses pthread_cond_wait which sometimes fails to unblock.
 			// This seems to depend on how many threads are blocked.
-			::usleep(_framePeriod - lastFrameTime);
-		} else {
-//			printf("Processor took too long: %d us\n", lastFrameTime);
+			sleepUntil(deadline);
 		}
 	}
 	
 	vision.stop();
 }
 
+Time Processor::commandLatency() const
+{
+	const Time defaultLatency = max(0, (int)*_defaultCommandLatency) * 1000;
+	return *_commandPrediction ? _commandHistory.latency(defaultLatency) : defaultLatency;
+}
+
 void Processor::sendRadioData()
 {
     Packet::RadioTx *tx = _state.logFrame->mutable_radio_tx();
@@ -583,6 +728,7 @@ void Processor::sendRadioData()
 	}
 	
 	// Add RadioTx commands for visible robots and apply joystick input
+	const Time now = timestamp();
 	for (OurRobot *r : _state.self)
 	{
 		if (r->visible || _manualID == r->shell())
@@ -599,6 +745,13 @@ void Processor::sendRadioData()
 				JoystickControlValues controlVals = getJoystickControlValues();
 				applyJoystickControls(controlVals, txRobot, r);
 			}
+			
+			// Remember what the robot was told in m/s and rad/s, undoing the multipliers in MotionControl
+			const float velMultiplier = *r->config->velMultiplier;
+			const float angleVelMultiplier = *r->config->angleVelMultiplier;
+			_commandHistory.add(r->shell(), now,
+					velMultiplier ? Point(txRobot->body_x(), txRobot->body_y()) / velMultiplier : Point(),
+					angleVelMultiplier ? txRobot->body_w() * DegreesToRadians / angleVelMultiplier : 0);
 		}
 	}
 
@@ -681,29 +834,29 @@ JoystickControlValues Processor::getJoystickControlValues() {
 
 void Processor::defendPlusX(bool value)
 {
-	_defendPlusX = value;
+	post([this, value]() {
+		_defendPlusX = value;
 
-	if (_defendPlusX)
-	{
-		_teamAngle = -M_PI_2;
-	} else {
-		_teamAngle = M_PI_2;
-	}
+		if (_defendPlusX)
+		{
+			_teamAngle = -M_PI_2;
+		} else {
+			_teamAngle = M_PI_2;
+		}
 
-	recalculateWorldToTeamTransform();
+		recalculateWorldToTeamTransform();
+	});
 }
 
 void Processor::changeVisionChannel(int port)
 {
-	_loopMutex.lock();
-
-	vision.stop();
-
-	vision.simulation = _simulation;
-	vision.port = port;
-	vision.start();
+	post([this, port]() {
+		vision.stop();
 
-	_loopMutex.unlock();
+		vision.simulation = _simulation;
+		vision.port = port;
+		vision.start();
+	});
 }
 
 void Processor::recalculateWorldToTeamTransform() {
@@ -712,7 +865,10 @@ void Processor::recalculateWorldToTeamTransform() {
 }
 
 void Processor::setFieldDimensions(const Field_Dimensions &dims) {
-	Field_Dimensions::Current_Dimensions = dims;
-	recalculateWorldToTeamTransform();
-	_gameplayModule->sendFieldDimensionsToPython();
+	post([this, dims]() {
+		Field_Dimensions::Current_Dimensions = dims;
+		recalculateWorldToTeamTransform();
+		_gameplayModule->updateFieldObstacles();
+		_gameplayModule->sendFieldDimensionsToPython();
+	});
 }
@@ -7,18 +7,27 @@
 #include <QMutex>
 #include <QMutexLocker>
 
+#include <functional>
+#include <memory>
+#include <vector>
+
 #include <protobuf/LogFrame.pb.h>
 #include <Logger.hpp>
 #include <Geometry2d/TransformMatrix.hpp>
 #include <SystemState.hpp>
 #include <modeling/RobotFilter.hpp>
+#include <modeling/CommandHistory.hpp>
+#include <modeling/OrientationFilter.hpp>
 #include <NewRefereeModule.hpp>
 #include "VisionReceiver.hpp"
+#include "LoopTiming.hpp"
+#include "VisionClock.hpp"
+#include <joystick/Joystick.hpp>
 
 class Configuration;
+class ConfigBool;
+class ConfigInt;
 class RobotStatus;
-class Joystick;
-struct JoystickControlValues;
 class Radio;
 class BallTracker;
 
@@ -69,6 +78,11 @@ public:
  * - handling the Configuration
  * - handling the Joystick
  * - running motion control for each robot (see OurRobot#motionControl)
+ *
+ * Other threads (the GUI and python UI) never lock anything the processing loop holds:
+ * - getters read the latest Snapshot, which is published at the end of each cycle
+ * - setters are queued as commands and run by the processing thread at the start of
+ *   the next cycle
  */
 class Processor: public QThread
 {
@@ -81,12 +95,47 @@ class Processor: public QThread
 				lastVisionTime = 0;
 				lastRefereeTime = 0;
 				lastRadioRxTime = 0;
+				
+				for (int i = 0; i < VisionClock::MaxCameras; ++i)
+				{
+					visionLatency[i] = 0;
+				}
 			}
 			
 			Time lastLoopTime;
 			Time lastVisionTime;
 			Time lastRefereeTime;
 			Time lastRadioRxTime;
+			
+			/// Recent latency of each stage of the processing loop
+			LoopTimingStats::Summary timing[LoopTimingStats::NumStages];
+			
+			/// Estimated time from capture to receipt for each camera, in seconds.
+			/// Zero for cameras we haven't heard from.
+			float visionLatency[VisionClock::MaxCameras];
+		};
+		
+		/**
+		 * @brief Immutable copy of processing loop state for other threads
+		 * @details A new Snapshot is published at the end of every cycle.
+		 * Readers get a shared_ptr to the latest one, which stays valid as long as they keep it.
+		 */
+		struct Snapshot
+		{
+			Snapshot()
+			{
+				framerate = 0;
+				manualID = -1;
+				goalieID = -1;
+				joystickValid = false;
+			}
+			
+			Status status;
+			float framerate;
+			int manualID;
+			int goalieID;
+			bool joystickValid;
+			JoystickControlValues joystickControlValues;
 		};
 		
 		static void createConfiguration(Configuration *cfg);
@@ -96,8 +145,25 @@ class Processor: public QThread
 		
 		void stop();
 		
+		/// Returns the state published at the end of the most recent cycle
+		std::shared_ptr<const Snapshot> snapshot() const
+		{
+			return std::atomic_load(&_snapshot);
+		}
+		
+		/// Runs @command on the processing thread at the start of the next cycle.
+		/// If the processing thread isn't running, the command runs immediately.
+		void post(const std::function<void()> &command);
+		
 		bool autonomous();
-		bool joystickValid();
+		bool joystickValid()
+		{
+			return snapshot()->joystickValid;
+		}
+		
+		/// Combined values of all joysticks.
+		/// Only the processing thread should call this.  Other threads should use
+		/// Snapshot::joystickControlValues.
 		JoystickControlValues getJoystickControlValues();
 
 		void externalReferee(bool value)
@@ -111,10 +177,12 @@ class Processor: public QThread
 		}
 		
 		void manualID(int value);
+		
+		/// The manual ID as of the last snapshot.
+		/// A value passed to manualID(int) doesn't show up here until the next cycle.
 		int manualID()
 		{
-			QMutexLocker lock(&_loopMutex);
-			return _manualID;
+			return snapshot()->manualID;
 		}
 		
 		/**
@@ -126,7 +194,10 @@ class Processor: public QThread
 		/**
 		 * @brief Shell ID of the goalie robot
 		 */
-		int goalieID();
+		int goalieID()
+		{
+			return snapshot()->goalieID;
+		}
 
 		void dampedRotation(bool value);
 		void dampedTranslation(bool value);
@@ -161,13 +232,12 @@ class Processor: public QThread
 		
 		Status status()
 		{
-			QMutexLocker lock(&_statusMutex);
-			return _status;
+			return snapshot()->status;
 		}
 		
 		float framerate()
 		{
-			return _framerate;
+			return snapshot()->framerate;
 		}
 		
 		const Logger &logger() const
@@ -188,12 +258,12 @@ class Processor: public QThread
 		// Use all/part of the field
 		void useOurHalf(bool value)
 		{
-			_useOurHalf = value;
+			post([this, value]() { _useOurHalf = value; });
 		}
 		
 		void useOpponentHalf(bool value)
 		{
-			_useOpponentHalf = value;
+			post([this, value]() { _useOpponentHalf = value; });
 		}
 		
 		QMutex &loopMutex()
@@ -230,12 +300,42 @@ class Processor: public QThread
 
 		// per-robot status configs
 		static std::vector<RobotStatus*> robotStatuses;
+
+		// If true, a new cycle starts as soon as detection frames from
+		// _visionCameras cameras have arrived instead of waiting for the timer.
+		// The frame period is still used as a deadline in case vision stops.
+		static ConfigBool *_visionTriggered;
+		static ConfigInt *_visionCameras;
+		
+		// If set, vision datagrams are logged as received (raw_vision_bytes) instead of
+		// being copied into raw_vision and serialized again by the logger.
+		static ConfigBool *_logVisionBytes;
+		
+		// If set, our robots are moved from where they were last seen to command_time
+		// by following the commands they were sent (see CommandHistory).
+		static ConfigBool *_commandPrediction;
+		
+		// Time in ms from sending a command to the robot following it, used until
+		// CommandHistory has an estimate or if command prediction is off
+		static ConfigInt *_defaultCommandLatency;
+		
+		// If set, our robots' angles come from their IMUs when available (see OrientationFilter)
+		static ConfigBool *_imuFusion;
+		
+		/// Time from now at which commands sent this cycle will take effect
+		Time commandLatency() const;
 		
 		/** send out the radio data for the radio program */
 		void sendRadioData();
 
 		void runModels(const std::vector<const SSL_DetectionFrame *> &detectionFrames);
 		
+		/// Runs commands queued by post()
+		void runCommands();
+		
+		/// Publishes a new Snapshot for other threads
+		void publishSnapshot(const Status &status);
+		
 		/** Used to start and stop the thread **/
 		volatile bool _running;
 
@@ -254,7 +354,7 @@ class Processor: public QThread
 		bool _blueTeam;
 		
 		// Locked when processing loop stuff is happening (not when blocked for timing or I/O).
-		// This is public so the GUI thread can lock it to access SystemState, etc.
+		// Other threads should use snapshot() and post() rather than locking this.
 		DebugQMutex _loopMutex;
 		
 		/** global system state */
@@ -282,14 +382,31 @@ class Processor: public QThread
 		/// Measured framerate
 		float _framerate;
 		
-		// This is used by the GUI to indicate status of the processing loop and network
-		QMutex _statusMutex;
-		Status _status;
+		/// Rolling statistics of each frame's LoopTiming.
+		/// Only used by the processing thread: summaries are published through _status.
+		LoopTimingStats _timingStats;
+		
+		// Latest published state.
+		// Only accessed with std::atomic_load/std::atomic_store.
+		std::shared_ptr<const Snapshot> _snapshot;
+		
+		// Commands from other threads waiting to be run by the processing thread.
+		// _commandMutex is only held long enough to add a command or swap the vectors,
+		// never while commands run.
+		QMutex _commandMutex;
+		std::vector<std::function<void()> > _commands;
+		
+		// Commands being run by the processing thread.
+		// This is kept between cycles so its storage is reused.
+		std::vector<std::function<void()> > _runningCommands;
 
 		//modules
 		std::shared_ptr<NewRefereeModule> _refereeModule;
 		std::shared_ptr<Gameplay::GameplayModule> _gameplayModule;
 		std::shared_ptr<BallTracker> _ballTracker;
+		RobotFilter _robotFilter;
+		CommandHistory _commandHistory;
+		OrientationFilter _orientationFilter;
 
 		//	mixes values from all joysticks to control the single manual robot
 		std::vector<Joystick *> _joysticks;
@@ -299,4 +416,7 @@ class Processor: public QThread
 		bool _dampedTranslation;
 
 		VisionReceiver vision;
+		
+		/// Converts vision timestamps to our clock
+		VisionClock _visionClock;
 };
@@ -8,6 +8,7 @@
 #include <QTimer>
 #include <stdio.h>
 #include <google/protobuf/descriptor.h>
+#include <protobuf/LogFrame.pb.h>
 
 using namespace std;
 using namespace google::protobuf;
@@ -32,6 +33,8 @@ ProtobufTree::ProtobufTree(QWidget *parent):
 	_history = 0;
 	mainWindow = 0;
 	updateTimer = 0;
+	
+	_bytesMessages.insert(Packet::LogFrame::descriptor()->FindFieldByName("raw_vision_bytes"), &SSL_WrapperPacket::default_instance());
 }
 
 bool ProtobufTree::message(const google::protobuf::Message& msg)
@@ -235,8 +238,24 @@ bool ProtobufTree::addTreeData(QTreeWidgetItem *parent, const google::protobuf::
 						break;
 					
 					case FieldDescriptor::TYPE_BYTES:
-						addBytes(child, ref->GetRepeatedString(msg, field, i));
+					{
+						const std::string &bytes = ref->GetRepeatedString(msg, field, i);
+						const Message *type = _bytesMessages.value(field);
+						if (type)
+						{
+							unique_ptr<Message> parsed(type->New());
+							if (parsed->ParseFromString(bytes))
+							{
+								child->setText(Column_Value, QString("%1 bytes").arg(bytes.size()));
+								child->setData(Column_Tag, IsMessageRole, true);
+								newFields |= addTreeData(child, *parsed);
+								break;
+							}
+						}
+						
+						addBytes(child, bytes);
 						break;
+					}
 					
 					default:
 						child->setText(Column_Value, QString("??? %1").arg(field->type()));
@@ -384,6 +403,20 @@ void ProtobufTree::collapseSubtree(QTreeWidgetItem* item)
 	}
 }
 
+bool ProtobufTree::insideBytes(QTreeWidgetItem* item) const
+{
+	for (QTreeWidgetItem *i = item->parent(); i; i = i->parent())
+	{
+		const FieldDescriptor *field = i->data(Column_Tag, FieldDescriptorRole).value<const FieldDescriptor *>();
+		if (field && field->type() == FieldDescriptor::TYPE_BYTES)
+		{
+			return true;
+		}
+	}
+	
+	return false;
+}
+
 void ProtobufTree::contextMenuEvent(QContextMenuEvent* e)
 {
 	QMenu menu;
@@ -418,7 +451,7 @@ void ProtobufTree::contextMenuEvent(QContextMenuEvent* e)
 	if (mainWindow && item)
 	{
 		field = item->data(Column_Tag, FieldDescriptorRole).value<const FieldDescriptor *>();
-		if (field)
+		if (field && !insideBytes(item))
 		{
 			int t = field->type();
 			if (t == FieldDescriptor::TYPE_FLOAT || t == FieldDescriptor::TYPE_DOUBLE || (t == FieldDescriptor::TYPE_MESSAGE && field->message_type()->name() == "Point"))
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <memory>
+#include <QMap>
 #include <QTreeWidget>
 #include <google/protobuf/message.h>
 
@@ -59,8 +60,16 @@ class ProtobufTree: public QTreeWidget
 		
 		void addBytes(QTreeWidgetItem *parent, const std::string &bytes);
 		
+		// Returns true if @item is inside a message that was parsed from a bytes field.
+		// Such fields can't be reached by reflection from the LogFrame, so they can't be charted.
+		bool insideBytes(QTreeWidgetItem *item) const;
+		
 		virtual void contextMenuEvent(QContextMenuEvent *e);
 		
 		bool _first;
 		const std::vector<std::shared_ptr<Packet::LogFrame> > *_history;
+		
+		// Bytes fields that hold serialized messages, and the type of message in each.
+		// These are parsed and shown as messages only when a frame is displayed.
+		QMap<const google::protobuf::FieldDescriptor *, const google::protobuf::Message *> _bytesMessages;
 };
@@ -5,7 +5,6 @@
 #include <protobuf/LogFrame.pb.h>
 #include <SystemState.hpp>
 #include <RobotConfig.hpp>
-#include <modeling/RobotFilter.hpp>
 
 #include <stdio.h>
 #include <iostream>
@@ -39,16 +38,10 @@ Robot::Robot(unsigned int shell, bool self)
 	_self = self;
 	angle = 0;
 	angleVel = 0;
-	
-	_filter = new RobotFilter();
 }
-/**
- * deconstructor, deletesRobotFilter
- */
+
 Robot::~Robot()
 {
-	delete _filter;
-	_filter = nullptr;
 }
 
 
@@ -500,19 +493,15 @@ void OurRobot::resetAvoidBall() {
 	avoidBallRadius(Ball_Avoid_Small);
 }
 
-std::shared_ptr<Geometry2d::Shape> OurRobot::createBallObstacle() const {
+float OurRobot::ballObstacleRadius() const {
 	// if game is stopped, large obstacle regardless of flags
 	if (_state->gameState.state != GameState::Playing && !(_state->gameState.ourRestart || _state->gameState.theirPenalty()))
 	{
-		return std::shared_ptr<Geometry2d::Shape>(new Circle(_state->ball.pos, Field_Dimensions::Current_Dimensions.CenterRadius()));
+		return Field_Dimensions::Current_Dimensions.CenterRadius();
 	}
 
 	// create an obstacle if necessary
-	if (_avoidBallRadius > 0.0) {
-		return std::shared_ptr<Geometry2d::Shape>(new Circle(_state->ball.pos, _avoidBallRadius));
-	} else {
-		return std::shared_ptr<Geometry2d::Shape>();
-	}
+	return std::max(_avoidBallRadius, 0.0f);
 }
 
 
@@ -553,7 +542,7 @@ int OurRobot::consecutivePathChangeCount() const {
 	return count > 0 ? count - 1 : 0;
 }
 
-void OurRobot::replanIfNeeded(const Geometry2d::CompositeShape& global_obstacles) {
+void OurRobot::replanIfNeeded(const ObstacleCache& obstacles, bool goalie, Time deadline) {
 	if (!_motionConstraints.targetPos) {
 		_path = boost::none;
 		return;
@@ -566,25 +555,50 @@ void OurRobot::replanIfNeeded(const Geometry2d::CompositeShape& global_obstacles
 		return;
 	}
 
-	// create and visualize obstacles
-	Geometry2d::CompositeShape full_obstacles(_local_obstacles);
+	// create and visualize obstacles.
+	// The world is rebuilt in place from the frame's shared obstacles, so this doesn't
+	// copy any shapes or allocate any once its storage has grown.
+	Planning::ObstacleWorld &world = _obstacleWorld;
+	world.clear();
+	world.add(_local_obstacles);
+
+	if (obstacles.ballValid())
+	{
+		float ballRadius = ballObstacleRadius();
+		if (ballRadius > 0)
+		{
+			world.addCircle(obstacles.ballPos(), ballRadius);
+			_state->drawCircle(obstacles.ballPos(), ballRadius, Qt::gray, QString("ball_obstacles_%1").arg(shell()));
+		}
+	}
+
 	//Add's our robots as obstacles only if they're within a certain distance from our robot.
 	//This distance increases with velocity.
-	Geometry2d::CompositeShape
-		self_obs = createRobotObstacles(_state->self, _self_avoid_mask, this->pos, 0.6 + this->vel.mag()),
-		opp_obs = createRobotObstacles(_state->opp, _opp_avoid_mask);
+	//NOTE: our own mask entry is never set, so this robot is not an obstacle to itself.
+	const float selfCheckRadius = 0.6 + this->vel.mag();
+	const QString selfLayer = QString("self_obstacles_%1").arg(shell());
+	for (int i = 0; i < Num_Shells; ++i)
+	{
+		const ObstacleCache::RobotEntry &r = obstacles.self(i);
+		if (_self_avoid_mask[i] > 0 && r.visible && pos.distTo(r.pos) <= selfCheckRadius)
+		{
+			world.addCircle(r.pos, _self_avoid_mask[i]);
+			_state->drawCircle(r.pos, _self_avoid_mask[i], Qt::gray, selfLayer);
+		}
+	}
 
-	_state->drawCompositeShape(self_obs, Qt::gray, QString("self_obstacles_%1").arg(shell()));
-	_state->drawCompositeShape(opp_obs, Qt::gray, QString("opp_obstacles_%1").arg(shell()));
-	if (_state->ball.valid)
+	const QString oppLayer = QString("opp_obstacles_%1").arg(shell());
+	for (int i = 0; i < Num_Shells; ++i)
 	{
-		std::shared_ptr<Geometry2d::Shape> ball_obs = createBallObstacle();
-		_state->drawShape(ball_obs, Qt::gray, QString("ball_obstacles_%1").arg(shell()));
-		full_obstacles.add(ball_obs);
+		const ObstacleCache::RobotEntry &r = obstacles.opp(i);
+		if (_opp_avoid_mask[i] > 0 && r.visible)
+		{
+			world.addCircle(r.pos, _opp_avoid_mask[i]);
+			_state->drawCircle(r.pos, _opp_avoid_mask[i], Qt::gray, oppLayer);
+		}
 	}
-	full_obstacles.add(self_obs);
-	full_obstacles.add(opp_obs);
-	full_obstacles.add(global_obstacles);
+
+	obstacles.addStatic(world, goalie);
 
 	// if no goal command robot to stop in place
 	if (!_motionConstraints.targetPos) {
@@ -609,14 +623,8 @@ void OurRobot::replanIfNeeded(const Geometry2d::CompositeShape& global_obstacles
 	}
 
 
-	Planning::Path newlyPlannedPath;
-	_planner->run(pos, angle, vel, _motionConstraints, &full_obstacles, newlyPlannedPath);
-
-	//	invalidate path if it hits obstacles
-	//	TODO: it would be better to compare WHICH obstacles the old and new paths hit rather than just looking at IF they hit obstacles
-	if (_path && _path->hit(full_obstacles) && !newlyPlannedPath.hit(full_obstacles)) {
-		_pathInvalidated = true;
-	}
+	//	The checks below only look at the current path, so that planning is only done when it's needed.
+	//	Most frames this costs a collision check, not a plan.
 
 	//  invalidate path if current position is more than 15cm from the planned point
 	if (_path) {
@@ -646,12 +654,16 @@ void OurRobot::replanIfNeeded(const Geometry2d::CompositeShape& global_obstacles
 		_pathInvalidated = true;
 	}
 
+	//	a path that is otherwise still good but runs into an obstacle ahead of us is repaired locally.
+	//	The part we've already driven doesn't matter.
+	bool blocked = !_pathInvalidated && _path->hit(world, max(0, _path->nearestIndex(pos)));
+
 	/*
 	//	try a straight path EVERY time
 	if (_path && _path->points.size() > 2) {
 		//	try a straight line path first
 		Geometry2d::Segment straight_seg(pos, *_motionConstraints.targetPos);
-		if (!full_obstacles.hit(straight_seg)) {
+		if (!world.hit(straight_seg)) {
 			addText(QString("planner: pre-emptive straight_line"));
 			Planning::Path straightLine(pos, *_motionConstraints.targetPos);
 			setPath(straightLine);
@@ -663,26 +675,37 @@ void OurRobot::replanIfNeeded(const Geometry2d::CompositeShape& global_obstacles
 
 
 	// check if goal is close to previous goal to reuse path
-	if (!_pathInvalidated) {
+	if (!_pathInvalidated && !blocked) {
 		addText("Reusing path");
 		// for (auto itr : _path->points) {
 		// 	cout << "\t(" << itr.x << ", " << itr.y << ")" << endl;
 		// }
 	} else {
-		addText("Replanning");
-		// use the newly generated path
-		if (verbose) cout << "in OurRobot::replanIfNeeded() for robot [" << shell() << "]: using new RRT path" << std::endl;
-		
-		//	try a straight line path first
-	//	Geometry2d::Segment straight_seg(pos, *_motionConstraints.targetPos);
-	//	if (!full_obstacles.hit(straight_seg)) {
-	//		addText(QString("planner: straight_line"));
-	//		Planning::Path straightLine(pos, *_motionConstraints.targetPos);
-	//		setPath(straightLine);
-	//	} else {
-			//	rrt-planned path
-			setPath(newlyPlannedPath);
-	//	}
+		Planning::Path newlyPlannedPath;
+		_planner->deadline(deadline);
+		if (blocked && _planner->repair(pos, vel, _motionConstraints, &world, newlyPlannedPath)) {
+			addText("Repairing path");
+		} else {
+			addText("Replanning");
+			_planner->run(pos, angle, vel, _motionConstraints, &world, newlyPlannedPath);
+		}
+
+		//	a blocked path is only replaced if the new one is clear
+		if (_pathInvalidated || !newlyPlannedPath.hit(world)) {
+			// use the newly generated path
+			if (verbose) cout << "in OurRobot::replanIfNeeded() for robot [" << shell() << "]: using new RRT path" << std::endl;
+			
+			//	try a straight line path first
+		//	Geometry2d::Segment straight_seg(pos, *_motionConstraints.targetPos);
+		//	if (!world.hit(straight_seg)) {
+		//		addText(QString("planner: straight_line"));
+		//		Planning::Path straightLine(pos, *_motionConstraints.targetPos);
+		//		setPath(straightLine);
+		//	} else {
+				//	rrt-planned path
+				setPath(newlyPlannedPath);
+		//	}
+		}
 	}
 
 
@@ -13,6 +13,8 @@
 #include <Utils.hpp>
 #include <planning/Path.hpp>
 #include <planning/RRTPlanner.hpp>
+#include <planning/ObstacleWorld.hpp>
+#include <ObstacleCache.hpp>
 #include <protobuf/RadioTx.pb.h>
 #include <protobuf/RadioRx.pb.h>
 
@@ -20,7 +22,6 @@ class SystemState;
 class RobotConfig;
 class RobotStatus;
 class MotionControl;
-class RobotFilter;
 
 namespace Packet
 {
@@ -92,14 +93,6 @@ public:
 		return _self;
 	}
 	
-	/**
-	 * Get the robot's position filter.
-	 */
-	RobotFilter *filter() const
-	{
-		return _filter;
-	}
-
 	bool operator==(const Robot &other) {
 		return shell() == other.shell() && self() == other.self();
 	}
@@ -111,7 +104,6 @@ public:
 private:
 	unsigned int _shell;
 	bool _self;
-	RobotFilter *_filter;
 };
 
 
@@ -345,8 +337,14 @@ public:
 	/**
 	 * Replans the path if needed.
 	 * Sets some parameters on the path.
+	 *
+	 * @param obstacles is this frame's shared obstacles.  Robots and the ball are taken from it
+	 *        according to this robot's avoidance settings.
+	 * @param goalie is true if this robot is the goalie, which doesn't avoid the goal area
+	 * @param deadline is the monotonicTimestamp() by which planning must be done, or zero for no limit.
+	 *        See Planning::RRTPlanner::deadline().
 	 */
-	void replanIfNeeded(const Geometry2d::CompositeShape& global_obstacles);
+	void replanIfNeeded(const ObstacleCache& obstacles, bool goalie, Time deadline = 0);
 
 
 	/** status evaluations for choosing robots in behaviors - combines multiple checks */
@@ -407,6 +405,7 @@ protected:
 	// obstacle management
 	Geometry2d::CompositeShape _local_obstacles; /// set of obstacles added by plays
 	RobotMask _self_avoid_mask, _opp_avoid_mask;  /// masks for obstacle avoidance
+	Planning::ObstacleWorld _obstacleWorld; /// planning obstacles, rebuilt in place by replanIfNeeded()
 	float _avoidBallRadius; /// radius of ball obstacle
 
 	MotionConstraints _motionConstraints;
@@ -423,51 +422,9 @@ protected:
 
 
 	/**
-	 * Creates a set of obstacles from a given robot team mask,
-	 * where mask values < 0 create no obstacle, and larger values
-	 * create an obstacle of a given radius
-	 *
-	 * NOTE: mask must not be set for this robot
-	 *
-	 * @param robots is the set of robots to use to create a mask - either self or opp from _state
-	 */
-	template<class ROBOT>
-	Geometry2d::CompositeShape createRobotObstacles(const std::vector<ROBOT*>& robots, const RobotMask& mask) const {
-		Geometry2d::CompositeShape result;
-		for (size_t i=0; i<RobotMask::size(); ++i)
-			if (mask[i] > 0 && robots[i] && robots[i]->visible)
-				result.add(std::shared_ptr<Geometry2d::Shape>(new Geometry2d::Circle(robots[i]->pos, mask[i])));
-		return result;
-	}
-
-
-	/**
-	 * Only adds obstacles within the checkRadius of the passed in position
-	 * Creates a set of obstacles from a given robot team mask,
-	 * where mask values < 0 create no obstacle, and larger values
-	 * create an obstacle of a given radius
-	 *
-	 * NOTE: mask must not be set for this robot
-	 *
-	 * @param robots is the set of robots to use to create a mask - either self or opp from _state
-	 */
-	template<class ROBOT>
-	Geometry2d::CompositeShape createRobotObstacles(const std::vector<ROBOT*>& robots, const RobotMask& mask,
-				 Geometry2d::Point currentPosition, float checkRadius) const {
-		Geometry2d::CompositeShape result;
-		for (size_t i=0; i<RobotMask::size(); ++i)
-			if (mask[i] > 0 && robots[i] && robots[i]->visible) {
-				if (currentPosition.distTo(robots[i]->pos)<=checkRadius) {
-					result.add(std::shared_ptr<Geometry2d::Shape>(new Geometry2d::Circle(robots[i]->pos, mask[i])));
-				}
-			}
-		return result;
-	}
-
-	/**
-	 * Creates an obstacle for the ball if necessary
+	 * Radius of the obstacle this robot should have around the ball, or zero for none
 	 */
-	std::shared_ptr<Geometry2d::Shape> createBallObstacle() const;
+	float ballObstacleRadius() const;
 
 protected:
 	friend class Processor;
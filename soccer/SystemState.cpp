@@ -7,6 +7,9 @@
 
 using namespace Packet;
 
+// Set by SystemState::DrawRedirect
+static thread_local LogFrame *redirectedDrawFrame = 0;
+
 SystemState::SystemState()
 {
 	timestamp = 0;
@@ -38,6 +41,7 @@ int SystemState::findDebugLayer(QString layer)
 		layer = "Debug";
 	}
 	
+	QMutexLocker lock(&_debugLayerMutex);
 	QMap<QString, int>::const_iterator i = _debugLayerMap.find(layer);
 	if (i == _debugLayerMap.end())
 	{
@@ -52,9 +56,39 @@ int SystemState::findDebugLayer(QString layer)
 	}
 }
 
+LogFrame *SystemState::drawFrame() const
+{
+	return redirectedDrawFrame ? redirectedDrawFrame : logFrame.get();
+}
+
+SystemState::DrawRedirect::DrawRedirect(LogFrame *frame)
+{
+	_previous = redirectedDrawFrame;
+	redirectedDrawFrame = frame;
+}
+
+SystemState::DrawRedirect::~DrawRedirect()
+{
+	redirectedDrawFrame = _previous;
+}
+
+void SystemState::appendDrawing(LogFrame &frame)
+{
+	logFrame->mutable_debug_paths()->MergeFrom(frame.debug_paths());
+	logFrame->mutable_debug_polygons()->MergeFrom(frame.debug_polygons());
+	logFrame->mutable_debug_circles()->MergeFrom(frame.debug_circles());
+	logFrame->mutable_debug_texts()->MergeFrom(frame.debug_texts());
+	
+	// Clear() keeps the allocated elements for the next frame
+	frame.mutable_debug_paths()->Clear();
+	frame.mutable_debug_polygons()->Clear();
+	frame.mutable_debug_circles()->Clear();
+	frame.mutable_debug_texts()->Clear();
+}
+
 void SystemState::drawPath(const Planning::Path &path, const QColor& qc, const QString& layer)
 {
-	DebugPath *dbg = logFrame->add_debug_paths();
+	DebugPath *dbg = drawFrame()->add_debug_paths();
 	dbg->set_layer(findDebugLayer(layer));
 	for (Geometry2d::Point pt : path.points)
 	{
@@ -65,7 +99,7 @@ void SystemState::drawPath(const Planning::Path &path, const QColor& qc, const Q
 
 void SystemState::drawPolygon(const Geometry2d::Point* pts, int n, const QColor& qc, const QString &layer)
 {
-	DebugPath *dbg = logFrame->add_debug_polygons();
+	DebugPath *dbg = drawFrame()->add_debug_polygons();
 	dbg->set_layer(findDebugLayer(layer));
 	for (int i = 0; i < n; ++i)
 	{
@@ -76,7 +110,7 @@ void SystemState::drawPolygon(const Geometry2d::Point* pts, int n, const QColor&
 
 void SystemState::drawPolygon(const std::vector<Geometry2d::Point>& pts, const QColor &qc, const QString &layer)
 {
-	DebugPath *dbg = logFrame->add_debug_polygons();
+	DebugPath *dbg = drawFrame()->add_debug_polygons();
 	dbg->set_layer(findDebugLayer(layer));
 	for (size_t i = 0; i < pts.size(); ++i)
 	{
@@ -87,7 +121,7 @@ void SystemState::drawPolygon(const std::vector<Geometry2d::Point>& pts, const Q
 
 void SystemState::drawCircle(const Geometry2d::Point& center, float radius, const QColor& qc, const QString &layer)
 {
-	DebugCircle *dbg = logFrame->add_debug_circles();
+	DebugCircle *dbg = drawFrame()->add_debug_circles();
 	dbg->set_layer(findDebugLayer(layer));
 	*dbg->mutable_center() = center;
 	dbg->set_radius(radius);
@@ -111,7 +145,7 @@ void SystemState::drawCompositeShape(const Geometry2d::CompositeShape& group, co
 
 void SystemState::drawLine(const Geometry2d::Line& line, const QColor& qc, const QString &layer)
 {
-	DebugPath *dbg = logFrame->add_debug_paths();
+	DebugPath *dbg = drawFrame()->add_debug_paths();
 	dbg->set_layer(findDebugLayer(layer));
 	*dbg->add_points() = line.pt[0];
 	*dbg->add_points() = line.pt[1];
@@ -125,7 +159,7 @@ void SystemState::drawLine(const Geometry2d::Point &p0, const Geometry2d::Point
 
 void SystemState::drawText(const QString& text, const Geometry2d::Point& pos, const QColor& qc, const QString &layer)
 {
-	DebugText *dbg = logFrame->add_debug_texts();
+	DebugText *dbg = drawFrame()->add_debug_texts();
 	dbg->set_layer(findDebugLayer(layer));
 	dbg->set_text(text.toStdString());
 	*dbg->mutable_pos() = pos;
@@ -6,6 +6,7 @@
 
 #include <QMap>
 #include <QColor>
+#include <QMutex>
 
 #include <Geometry2d/Point.hpp>
 #include <protobuf/RadioTx.pb.h>
@@ -89,6 +90,25 @@ public:
 	/** @ingroup drawing_functions */
 	void drawCompositeShape(const Geometry2d::CompositeShape& group, const QColor &color = Qt::black, const QString &layer = QString());
 	
+	/**
+	 * While one of these exists, drawing functions called on the same thread add to
+	 * @a frame instead of logFrame.  This lets tasks running on other threads draw
+	 * without sharing logFrame; the main thread then copies their drawing over with
+	 * appendDrawing().
+	 */
+	class DrawRedirect
+	{
+	public:
+		DrawRedirect(Packet::LogFrame *frame);
+		~DrawRedirect();
+		
+	private:
+		Packet::LogFrame *_previous;
+	};
+	
+	/// Appends the drawing in @a frame to logFrame and clears it from @a frame.
+	void appendDrawing(Packet::LogFrame &frame);
+	
 	Time timestamp;
 	GameState gameState;
 	
@@ -111,10 +131,16 @@ public:
 		return _debugLayers;
 	}
 
-	/// Returns the number of a debug layer given its name
+	/// Returns the number of a debug layer given its name.
+	/// This may be called from any thread.
 	int findDebugLayer(QString layer);
 	
 private:
+	/// Frame that drawing functions on the current thread add to
+	Packet::LogFrame *drawFrame() const;
+	
+	/// Protects the debug layer list
+	QMutex _debugLayerMutex;
 	
 	/// Map from debug layer name to ID
 	QMap<QString, int> _debugLayerMap;
@@ -0,0 +1,93 @@
+#include "VisionClock.hpp"
+
+#include <string.h>
+
+/// Largest drift we believe, in seconds per second.
+/// Anything more is noise from a short window.
+static const double Max_Drift = 1e-3;
+
+/// Weight of each new sample in the smoothed latency
+static const double Latency_Alpha = 0.05;
+
+VisionClock::VisionClock()
+{
+	memset(_cameras, 0, sizeof(_cameras));
+}
+
+double VisionClock::update(unsigned int camera, double received, double sent, double captured)
+{
+	Camera &cam = _cameras[camera % MaxCameras];
+
+	cam.received[cam.next] = received;
+	cam.rawOffset[cam.next] = received - sent;
+	cam.next = (cam.next + 1) % Window;
+	if (cam.count < Window)
+	{
+		++cam.count;
+	}
+
+	estimate(cam);
+	double offset = cam.offset + cam.drift * (received - cam.t0);
+
+	double latency = received - (captured + offset);
+	if (cam.latency == 0)
+	{
+		cam.latency = latency;
+	} else {
+		cam.latency += (latency - cam.latency) * Latency_Alpha;
+	}
+
+	return offset;
+}
+
+void VisionClock::estimate(Camera &cam)
+{
+	// Find the minimum offset in the older and newer halves of the window.
+	// Index 0 is the oldest sample.
+	int start = (cam.count < Window) ? 0 : cam.next;
+	int half = cam.count / 2;
+
+	int oldMin = -1, newMin = -1;
+	for (int i = 0; i < cam.count; ++i)
+	{
+		int j = (start + i) % Window;
+		int &best = (i < half) ? oldMin : newMin;
+		if (best < 0 || cam.rawOffset[j] < cam.rawOffset[best])
+		{
+			best = j;
+		}
+	}
+
+	cam.t0 = cam.received[newMin];
+	cam.offset = cam.rawOffset[newMin];
+	cam.drift = 0;
+
+	if (oldMin >= 0 && cam.count == Window)
+	{
+		double dt = cam.received[newMin] - cam.received[oldMin];
+		if (dt > 0)
+		{
+			double drift = (cam.rawOffset[newMin] - cam.rawOffset[oldMin]) / dt;
+			if (drift > -Max_Drift && drift < Max_Drift)
+			{
+				cam.drift = drift;
+			}
+		}
+	}
+}
+
+double VisionClock::offset(unsigned int camera, double t) const
+{
+	const Camera &cam = _cameras[camera % MaxCameras];
+	return cam.offset + cam.drift * (t - cam.t0);
+}
+
+double VisionClock::drift(unsigned int camera) const
+{
+	return _cameras[camera % MaxCameras].drift;
+}
+
+double VisionClock::latency(unsigned int camera) const
+{
+	return _cameras[camera % MaxCameras].latency;
+}
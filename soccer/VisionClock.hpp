@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Estimates the offset between the SSL-Vision computer's clock and ours
+ *
+ * @details
+ * Each detection frame has t_capture and t_sent in the vision computer's clock.
+ * The difference between our receive time and t_sent is the clock offset plus the
+ * network and scheduling delay, which is never negative and is usually near its
+ * minimum.  The smallest difference over a sliding window is therefore a good estimate
+ * of the offset (plus the minimum network latency, which we can't observe).
+ *
+ * Clock drift is estimated from the change in the minimum between the older and newer
+ * halves of the window, so the offset can be extrapolated between minima.
+ *
+ * Each camera is tracked separately in case they are on different computers.
+ * All times are in seconds.
+ */
+class VisionClock
+{
+public:
+	static const int MaxCameras = 8;
+
+	/// Number of packets per camera used for the estimate (about four seconds at 60 Hz)
+	static const int Window = 256;
+
+	VisionClock();
+
+	/// Adds a frame's timestamps and returns the current offset estimate for its camera.
+	/// Add this to vision timestamps to convert them to our clock.
+	///
+	/// @received is our clock, @sent and @captured are the vision computer's clock.
+	double update(unsigned int camera, double received, double sent, double captured);
+
+	/// Estimated offset from the camera's clock to ours at local time @t
+	double offset(unsigned int camera, double t) const;
+
+	/// Estimated clock drift of the camera relative to ours, in seconds per second
+	double drift(unsigned int camera) const;
+
+	/// Average time from capture to receipt of recent frames from a camera, using the
+	/// estimated offset.  Returns zero if nothing has been received from the camera.
+	double latency(unsigned int camera) const;
+
+private:
+	struct Camera
+	{
+		/// Local receive times and raw offsets of recent packets
+		double received[Window];
+		double rawOffset[Window];
+		int next;
+		int count;
+
+		/// Current estimate: offset at time t0, changing by drift per second
+		double t0;
+		double offset;
+		double drift;
+
+		/// Smoothed capture-to-receive latency
+		double latency;
+	};
+
+	void estimate(Camera &cam);
+
+	Camera _cameras[MaxCameras];
+};
@@ -2,18 +2,38 @@
 
 #include <multicast.hpp>
 #include <Utils.hpp>
+#include <errno.h>
+#include <string.h>
 #include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
 #include <QMutexLocker>
 #include <QUdpSocket>
 #include <stdexcept>
 
 using namespace std;
 
-VisionReceiver::VisionReceiver(bool sim, int port)
+VisionReceiver::VisionReceiver(bool sim, int port):
+	_pool(PoolSize)
 {
 	simulation = sim;
 	_running = false;
+	_pendingCameras = 0;
+	_dropped = 0;
+	_batchSize = 0;
 	this->port = port;
+
+	for (VisionPacket &packet : _pool)
+	{
+		VisionPacket *p = &packet;
+		_free.push(p);
+	}
+}
+
+VisionReceiver::~VisionReceiver()
+{
+	stop();
 }
 
 void VisionReceiver::stop()
@@ -24,10 +44,50 @@ void VisionReceiver::stop()
 
 void VisionReceiver::getPackets(std::vector<VisionPacket *>& packets)
 {
-	_mutex.lock();
-	packets = _packets;
-	_packets.clear();
-	_mutex.unlock();
+	// Clear this first so a frame that arrives while we're reading the queue
+	// will still wake up the next waitForFrames().
+	_pendingCameras = 0;
+
+	packets.clear();
+	VisionPacket *packet;
+	while (_received.pop(packet))
+	{
+		packets.push_back(packet);
+	}
+}
+
+void VisionReceiver::recycle(VisionPacket *packet)
+{
+	// The pool has exactly as many packets as the queue has slots, so this can't fail
+	_free.push(packet);
+}
+
+bool VisionReceiver::waitForFrames(Time deadline, int cameras)
+{
+	QMutexLocker locker(&_mutex);
+	while (__builtin_popcount(_pendingCameras) < cameras)
+	{
+		Time now = monotonicTimestamp();
+		if (now >= deadline)
+		{
+			return false;
+		}
+
+		// QWaitCondition only has millisecond resolution, so sleep out the
+		// last partial millisecond precisely.
+		unsigned long ms = (deadline - now) / 1000;
+		if (ms == 0)
+		{
+			locker.unlock();
+			sleepUntil(deadline);
+			locker.relock();
+			return __builtin_popcount(_pendingCameras) >= cameras;
+		}
+
+		_frameReceived.wait(&_mutex, ms);
+	}
+
+	return true;
 }
 
 void VisionReceiver::run()
@@ -56,47 +116,151 @@ void VisionReceiver::run()
 		multicast_add(&socket, SharedVisionAddress);
 	}
 	
-	// There should be at most four packets: one for each camera on each of two frames, assuming some clock skew between this
-	// computer and the vision computer.
-	_packets.reserve(4);
+	// QUdpSocket is only used to set up the socket.
+	// Datagrams are read directly so we can get several with one syscall.
+	int fd = socket.socketDescriptor();
+	
+	// Have the kernel timestamp each datagram when it arrives, so the receive time
+	// doesn't include how long it took for this thread to be scheduled.
+	int one = 1;
+	if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) != 0)
+	{
+		fprintf(stderr, "VisionReceiver: can't enable kernel timestamps, using receive time: %m\n");
+	}
+	
+	struct mmsghdr msgs[BatchSize];
+	struct iovec iovecs[BatchSize];
+	struct sockaddr_storage addrs[BatchSize];
+	char control[BatchSize][CMSG_SPACE(sizeof(struct timespec))];
+	
+	// Datagrams that arrive when there are no free packets are read into this and dropped
+	static char discard[VisionPacket::MaxSize];
 	
 	_running = true;
 	while (_running)
 	{
-		char buf[65536];
+		// Wait for a UDP packet.
+		// Time out once in a while so the thread has a chance to exit.
+		struct pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, 500) <= 0)
+		{
+			continue;
+		}
+		
+		// Get as many free packets as we can use
+		VisionPacket *packet;
+		while (_batchSize < BatchSize && _free.pop(packet))
+		{
+			_batch[_batchSize++] = packet;
+		}
 		
-		// Wait for a UDP packet
-		if (!socket.waitForReadyRead(500))
+		if (_batchSize == 0)
 		{
-			// Time out once in a while so the thread has a chance to exit
+			// The reader isn't keeping up, so throw away the oldest data
+			if (recv(fd, discard, sizeof(discard), MSG_DONTWAIT) > 0)
+			{
+				++_dropped;
+			}
 			continue;
 		}
 		
-		QHostAddress host;
-		quint16 portNumber = 0;
-		qint64 size = socket.readDatagram(buf, sizeof(buf), &host, &portNumber);
-		if (size < 1)
+		memset(msgs, 0, sizeof(msgs));
+		for (int i = 0; i < _batchSize; ++i)
 		{
-			fprintf(stderr, "VisionReceiver: %s\n", (const char *)socket.errorString().toLatin1());
-			// See Processor for why we can't use QThread::msleep()
-			::usleep(100 * 1000);
+			iovecs[i].iov_base = _batch[i]->data;
+			iovecs[i].iov_len = VisionPacket::MaxSize;
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+			msgs[i].msg_hdr.msg_control = control[i];
+			msgs[i].msg_hdr.msg_controllen = sizeof(control[i]);
+		}
+		
+		int n = recvmmsg(fd, msgs, _batchSize, MSG_DONTWAIT, 0);
+		if (n < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				fprintf(stderr, "VisionReceiver: %m\n");
+				// See Processor for why we can't use QThread::msleep()
+				::usleep(100 * 1000);
+			}
 			continue;
 		}
 		
+		// Used for any datagram without a kernel timestamp
+		Time wakeTime = timestamp();
+		
 		//FIXME - Verify that it is from the right host, in case there are multiple visions on the network
 		
-		// Parse the protobuf message
-		VisionPacket *packet = new VisionPacket;
-		packet->receivedTime = timestamp();
-		if (!packet->wrapper.ParseFromArray(buf, size))
+		uint32_t cameras = 0;
+		int used = 0;
+		for (int i = 0; i < n; ++i)
 		{
-			fprintf(stderr, "VisionReceiver: got bad packet of %d bytes from %s:%d\n", (int)size, (const char *)host.toString().toLatin1(), portNumber);
-			continue;
+			VisionPacket *packet = _batch[i];
+			packet->size = msgs[i].msg_len;
+			packet->receivedTime = wakeTime;
+			
+			for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg))
+			{
+				if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+				{
+					// Kernel timestamps use CLOCK_REALTIME, like timestamp()
+					struct timespec ts;
+					memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+					packet->receivedTime = (Time)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+				}
+			}
+			
+			// Parse the protobuf message.
+			// This reuses the memory of the last message parsed into this packet.
+			if (packet->size < 1 || !packet->wrapper.ParseFromArray(packet->data, packet->size))
+			{
+				char host[NI_MAXHOST], service[NI_MAXSERV];
+				if (getnameinfo((struct sockaddr *)&addrs[i], msgs[i].msg_hdr.msg_namelen,
+						host, sizeof(host), service, sizeof(service), NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+				{
+					strcpy(host, "?");
+					strcpy(service, "?");
+				}
+				fprintf(stderr, "VisionReceiver: got bad packet of %d bytes from %s:%s\n", packet->size, host, service);
+				
+				// Keep this packet for the next batch
+				_batch[used++] = packet;
+				continue;
+			}
+			
+			if (packet->wrapper.has_detection())
+			{
+				// Frames from cameras past the end of the mask are still processed,
+				// they just don't count towards waitForFrames()
+				const unsigned int camera = packet->wrapper.detection().camera_id();
+				if (camera < 32)
+				{
+					cameras |= 1u << camera;
+				}
+			}
+			
+			// There are as many queue slots as packets, so this can't fail
+			_received.push(packet);
+		}
+		
+		// Keep any packets we didn't fill
+		for (int i = n; i < _batchSize; ++i)
+		{
+			_batch[used++] = _batch[i];
 		}
+		_batchSize = used;
 		
-		// Add to the vector of packets
-		_mutex.lock();
-		_packets.push_back(packet);
-		_mutex.unlock();
+		if (cameras)
+		{
+			_pendingCameras |= cameras;
+			
+			QMutexLocker locker(&_mutex);
+			_frameReceived.wakeAll();
+		}
 	}
 }
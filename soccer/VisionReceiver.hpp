@@ -3,9 +3,12 @@
 #include <protobuf/messages_robocup_ssl_wrapper.pb.h>
 #include <Network.hpp>
 #include <Utils.hpp>
+#include <SpscQueue.hpp>
 
 #include <QThread>
 #include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
 #include <vector>
 #include <stdint.h>
 
@@ -14,11 +17,19 @@ class QUdpSocket;
 class VisionPacket
 {
 public:
-	/// Local time when the packet was received
+	/// Largest datagram we can receive
+	static const int MaxSize = 65536;
+
+	/// Local time when the packet was received.
+	/// This comes from the kernel if possible, so it doesn't include scheduling delay.
 	Time receivedTime;
 	
 	/// protobuf message from the vision system
 	SSL_WrapperPacket wrapper;
+
+	/// Received datagram.  Only the first @size bytes are valid.
+	char data[MaxSize];
+	int size;
 };
 
 
@@ -30,33 +41,82 @@ public:
  * If sim = true, it tries both simulator ports until one works.  Otherwise, it connects to the port
  * specified in the constructor.
  * 
- * Whenever a new packet comes in (encoded as Google Protobuf), it is parsed into an
- * SSL_WrapperPacket and placed onto the circular buffer @_packets.  They remain there
- * until they are retrieved with getPackets().
+ * All VisionPackets come from a fixed pool allocated by the constructor.  The receive thread
+ * reads several datagrams at once with recvmmsg() directly into free packets, parses each into
+ * its SSL_WrapperPacket, and passes them to the reader through a lock-free queue.  They remain
+ * there until they are retrieved with getPackets(), and the reader gives them back with recycle().
+ * If the reader doesn't keep up and the pool runs out, new datagrams are dropped.
+ *
+ * The processing loop can block in waitForFrames() to be woken as soon as
+ * detection frames from enough cameras have arrived instead of polling on a timer.
  */
 class VisionReceiver: public QThread
 {
 public:
 	VisionReceiver(bool sim = false, int port = SharedVisionPortSinglePrimary);
+	~VisionReceiver();
 
 	void stop();
 	
-	/// Copies the vector of packets and then clears it.
-	/// The vector contains only packets received since the last time this was called
+	/// Fills @packets with all packets received since the last time this was called
 	/// (or since the VisionReceiver was started, if getPackets has never been called).
 	///
-	/// The caller is responsible for freeing the packets after this function returns.
+	/// The caller must give each packet back with recycle() when it is done with it.
+	/// This and recycle() must only be called from one thread.
 	void getPackets(std::vector<VisionPacket *> &packets);
 
+	/// Returns a packet from getPackets() to the pool
+	void recycle(VisionPacket *packet);
+
+	/// Blocks until detection frames from at least @cameras distinct cameras
+	/// have been received since the last call to getPackets(), or until
+	/// @deadline (a monotonicTimestamp()) has passed.
+	///
+	/// Returns true if the frames arrived, false if the deadline passed first.
+	bool waitForFrames(Time deadline, int cameras = 1);
+
+	/// Number of datagrams dropped because no packets were free
+	int dropped() const
+	{
+		return _dropped;
+	}
+
 	bool simulation;
 	int port;
 	
 protected:
 	virtual void run();
+
+	/// Number of packets in the pool
+	static const int PoolSize = 32;
+
+	/// Most datagrams read by one recvmmsg() call
+	static const int BatchSize = 8;
 	
 	volatile bool _running;
 	
-	/// This mutex protects the vector of packets
+	/// All packets, allocated once
+	std::vector<VisionPacket> _pool;
+
+	/// Received packets waiting for getPackets()
+	SpscQueue<VisionPacket *, PoolSize> _received;
+
+	/// Packets given back by recycle()
+	SpscQueue<VisionPacket *, PoolSize> _free;
+
+	/// Free packets the receive thread has taken from _free but not filled yet
+	VisionPacket *_batch[BatchSize];
+	int _batchSize;
+
+	std::atomic<int> _dropped;
+
+	/// Bitmask of camera IDs that have delivered a detection frame since the last getPackets().
+	/// Only IDs below 32 are counted.
+	std::atomic<uint32_t> _pendingCameras;
+
+	/// Only used with _frameReceived, to wake up waitForFrames()
 	QMutex _mutex;
-	std::vector<VisionPacket *> _packets;
+
+	/// Signalled whenever a new detection frame is received
+	QWaitCondition _frameReceived;
 };
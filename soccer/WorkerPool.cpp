@@ -0,0 +1,104 @@
+#include "WorkerPool.hpp"
+
+WorkerPool::WorkerPool(int workers)
+{
+	_generation = 0;
+	_busy = 0;
+	_stop = false;
+	_task = 0;
+	_taskCount = 0;
+	_nextTask = 0;
+
+	for (int i = 0; i < workers; ++i)
+	{
+		Worker *worker = new Worker(this);
+		_workers.push_back(worker);
+		worker->start();
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	_mutex.lock();
+	_stop = true;
+	_start.wakeAll();
+	_mutex.unlock();
+
+	for (Worker *worker : _workers)
+	{
+		worker->wait();
+		delete worker;
+	}
+}
+
+void WorkerPool::run(int n, const std::function<void(int)> &task)
+{
+	if (_workers.empty() || n <= 1)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			task(i);
+		}
+		return;
+	}
+
+	_mutex.lock();
+	_task = &task;
+	_taskCount = n;
+	_nextTask = 0;
+	_busy = _workers.size();
+	++_generation;
+	_start.wakeAll();
+	_mutex.unlock();
+
+	// This thread works on the batch too instead of just waiting
+	runTasks();
+
+	_mutex.lock();
+	while (_busy > 0)
+	{
+		_finished.wait(&_mutex);
+	}
+	_task = 0;
+	_mutex.unlock();
+}
+
+void WorkerPool::runTasks()
+{
+	for (int i = _nextTask++; i < _taskCount; i = _nextTask++)
+	{
+		(*_task)(i);
+	}
+}
+
+void WorkerPool::workerLoop()
+{
+	// Workers are started before the first batch, so they all begin at generation zero
+	unsigned int seen = 0;
+
+	_mutex.lock();
+	while (true)
+	{
+		while (!_stop && _generation == seen)
+		{
+			_start.wait(&_mutex);
+		}
+
+		if (_stop)
+		{
+			break;
+		}
+
+		seen = _generation;
+		_mutex.unlock();
+
+		runTasks();
+
+		_mutex.lock();
+		if (--_busy == 0)
+		{
+			_finished.wakeAll();
+		}
+	}
+	_mutex.unlock();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief Persistent threads for splitting per-frame work into independent tasks
+ *
+ * @details
+ * run() hands out task indices to the worker threads and to the calling thread,
+ * and returns once every task has finished.  The threads are started once and
+ * sleep between calls, so there is no thread creation on the processing loop.
+ *
+ * Only one thread may call run() at a time.  Tasks must not throw.
+ */
+class WorkerPool
+{
+public:
+	/// Starts @workers threads.  With no workers, run() does everything on the calling thread.
+	explicit WorkerPool(int workers);
+	~WorkerPool();
+
+	int workers() const
+	{
+		return _workers.size();
+	}
+
+	/// Calls task(i) once for each i in [0, n) and waits for all of them.
+	void run(int n, const std::function<void(int)> &task);
+
+private:
+	class Worker: public QThread
+	{
+	public:
+		Worker(WorkerPool *pool):
+			_pool(pool)
+		{
+		}
+
+	protected:
+		void run()
+		{
+			_pool->workerLoop();
+		}
+
+	private:
+		WorkerPool *_pool;
+	};
+
+	void workerLoop();
+
+	// Runs tasks from the current batch until there are none left
+	void runTasks();
+
+	std::vector<Worker *> _workers;
+
+	// Protects everything below except _nextTask
+	QMutex _mutex;
+
+	// Signalled when a batch starts or the pool is stopping
+	QWaitCondition _start;
+
+	// Signalled when the last worker leaves a batch
+	QWaitCondition _finished;
+
+	// Incremented for each batch so workers can tell a new batch from a spurious wakeup
+	unsigned int _generation;
+
+	// Number of workers that have not finished the current batch
+	int _busy;
+
+	bool _stop;
+
+	const std::function<void(int)> *_task;
+	int _taskCount;
+
+	// Index of the next task to hand out
+	std::atomic<int> _nextTask;
+};
@@ -4,6 +4,8 @@
 #include <protobuf/LogFrame.pb.h>
 #include <Robot.hpp>
 #include <SystemState.hpp>
+#include <LoopTiming.hpp>
+#include <Configuration.hpp>
 
 #include <stdio.h>
 #include <iostream>
@@ -18,87 +20,40 @@ using namespace boost::python;
 
 using namespace Geometry2d;
 
+namespace Gameplay
+{
+	REGISTER_CONFIGURABLE(GameplayModule)
+}
+
+ConfigBool *Gameplay::GameplayModule::_parallelPlanning;
+ConfigDouble *Gameplay::GameplayModule::_planningBudget;
+ConfigDouble *Gameplay::GameplayModule::_priorityPlanningWeight;
 
+void Gameplay::GameplayModule::createConfiguration(Configuration *cfg)
+{
+	_parallelPlanning = new ConfigBool(cfg, "Gameplay/Parallel Planning", true);
+	_planningBudget = new ConfigDouble(cfg, "Gameplay/Planning Budget (ms)", 6);
+	_priorityPlanningWeight = new ConfigDouble(cfg, "Gameplay/Priority Planning Weight", 2);
+}
+
+// The processing thread plans too, so it isn't counted in the pool
+static int planningWorkers()
+{
+	return max(0, min(QThread::idealThreadCount(), (int)Num_Shells) - 1);
+}
 
 Gameplay::GameplayModule::GameplayModule(SystemState *state):
-	_mutex(QMutex::Recursive)
+	_mutex(QMutex::Recursive),
+	_planningPool(planningWorkers())
 {
 	_state = state;
+	_planningDrawing.resize(Num_Shells);
 
 	_centerMatrix = Geometry2d::TransformMatrix::translate(Geometry2d::Point(0, Field_Dimensions::Current_Dimensions.Length() / 2));
 	_oppMatrix = Geometry2d::TransformMatrix::translate(Geometry2d::Point(0, Field_Dimensions::Current_Dimensions.Length())) *
 				Geometry2d::TransformMatrix::rotate(M_PI);
 
-	//// Make an obstacle to cover the opponent's half of the field except for one robot diameter across the center line.
-	Polygon *sidePolygon = new Polygon;
-	_sideObstacle = std::shared_ptr<Shape>(sidePolygon);
-	float x = Field_Dimensions::Current_Dimensions.Width() / 2 + Field_Dimensions::Current_Dimensions.Border();
-	const float y1 = Field_Dimensions::Current_Dimensions.Length() / 2;
-	const float y2 = Field_Dimensions::Current_Dimensions.Length() + Field_Dimensions::Current_Dimensions.Border();
-	const float r = Field_Dimensions::Current_Dimensions.CenterRadius();
-	sidePolygon->vertices.push_back(Geometry2d::Point(-x, y1));
-	sidePolygon->vertices.push_back(Geometry2d::Point(-r, y1));
-	sidePolygon->vertices.push_back(Geometry2d::Point(0, y1 + r));
-	sidePolygon->vertices.push_back(Geometry2d::Point(r, y1));
-	sidePolygon->vertices.push_back(Geometry2d::Point(x, y1));
-	sidePolygon->vertices.push_back(Geometry2d::Point(x, y2));
-	sidePolygon->vertices.push_back(Geometry2d::Point(-x, y2));
-
-	float y = -Field_Dimensions::Current_Dimensions.Border();
-	float deadspace = Field_Dimensions::Current_Dimensions.Border();
-	x = Field_Dimensions::Current_Dimensions.FloorWidth() /2.0f;
-	Polygon* floorObstacle = new Polygon;
-	floorObstacle->vertices.push_back(Geometry2d::Point(-x, y));
-	floorObstacle->vertices.push_back(Geometry2d::Point(-x, y-1));
-	floorObstacle->vertices.push_back(Geometry2d::Point(x, y-1));
-	floorObstacle->vertices.push_back(Geometry2d::Point(x, y));
-	_nonFloor[0] = std::shared_ptr<Shape>(floorObstacle);
-
-	y = Field_Dimensions::Current_Dimensions.Length() + Field_Dimensions::Current_Dimensions.Border();
-	floorObstacle = new Polygon;
-	floorObstacle->vertices.push_back(Geometry2d::Point(-x, y));
-	floorObstacle->vertices.push_back(Geometry2d::Point(-x, y+1));
-	floorObstacle->vertices.push_back(Geometry2d::Point(x, y+1));
-	floorObstacle->vertices.push_back(Geometry2d::Point(x, y));
-	_nonFloor[1] = std::shared_ptr<Shape>(floorObstacle);
-
-	y = Field_Dimensions::Current_Dimensions.FloorLength();
-	floorObstacle = new Polygon;
-	floorObstacle->vertices.push_back(Geometry2d::Point(-x, -deadspace));
-	floorObstacle->vertices.push_back(Geometry2d::Point(-x-1, -deadspace));
-	floorObstacle->vertices.push_back(Geometry2d::Point(-x-1, y));
-	floorObstacle->vertices.push_back(Geometry2d::Point(-x, y));
-	_nonFloor[2] = std::shared_ptr<Shape>(floorObstacle);
-
-	floorObstacle = new Polygon;
-	floorObstacle->vertices.push_back(Geometry2d::Point(x, -deadspace));
-	floorObstacle->vertices.push_back(Geometry2d::Point(x+1, -deadspace));
-	floorObstacle->vertices.push_back(Geometry2d::Point(x+1, y));
-	floorObstacle->vertices.push_back(Geometry2d::Point(x, y));
-	_nonFloor[3] = std::shared_ptr<Shape>(floorObstacle);
-
-	Polygon* goalArea = new Polygon;
-	const float halfFlat = Field_Dimensions::Current_Dimensions.GoalFlat() /2.0;
-	const float radius = Field_Dimensions::Current_Dimensions.ArcRadius();
-	goalArea->vertices.push_back(Geometry2d::Point(-halfFlat, 0));
-	goalArea->vertices.push_back(Geometry2d::Point(-halfFlat, radius));
-	goalArea->vertices.push_back(Geometry2d::Point( halfFlat, radius));
-	goalArea->vertices.push_back(Geometry2d::Point( halfFlat, 0));
-	_goalArea.add(std::shared_ptr<Shape>(goalArea));
-	_goalArea.add(std::shared_ptr<Shape>(new Circle(Geometry2d::Point(-halfFlat, 0), radius)));
-	_goalArea.add(std::shared_ptr<Shape>(new Circle(Geometry2d::Point(halfFlat, 0), radius)));
-
-	_ourHalf = std::make_shared<Polygon>();
-	_ourHalf->vertices.push_back(Geometry2d::Point(-x, -Field_Dimensions::Current_Dimensions.Border()));
-	_ourHalf->vertices.push_back(Geometry2d::Point(-x, y1));
-	_ourHalf->vertices.push_back(Geometry2d::Point(x, y1));
-	_ourHalf->vertices.push_back(Geometry2d::Point(x, -Field_Dimensions::Current_Dimensions.Border()));
-
-	_opponentHalf = std::make_shared<Polygon>();
-	_opponentHalf->vertices.push_back(Geometry2d::Point(-x, y1));
-	_opponentHalf->vertices.push_back(Geometry2d::Point(-x, y2));
-	_opponentHalf->vertices.push_back(Geometry2d::Point(x, y2));
-	_opponentHalf->vertices.push_back(Geometry2d::Point(x, y1));
+	updateFieldObstacles();
 
 	_goalieID = -1;
 
@@ -182,31 +137,136 @@ void Gameplay::GameplayModule::goalieID(int value)
 }
 
 /**
- * returns the group of obstacles for the field
+ * Builds the field obstacles and their distance fields for the current field dimensions
  */
-Geometry2d::CompositeShape Gameplay::GameplayModule::globalObstacles() const {
-	Geometry2d::CompositeShape obstacles;
+void Gameplay::GameplayModule::updateFieldObstacles()
+{
+	QMutexLocker lock(&_mutex);
+
+	//// Make an obstacle to cover the opponent's half of the field except for one robot diameter across the center line.
+	Polygon *sidePolygon = new Polygon;
+	_sideObstacle = std::shared_ptr<Shape>(sidePolygon);
+	float x = Field_Dimensions::Current_Dimensions.Width() / 2 + Field_Dimensions::Current_Dimensions.Border();
+	const float y1 = Field_Dimensions::Current_Dimensions.Length() / 2;
+	const float y2 = Field_Dimensions::Current_Dimensions.Length() + Field_Dimensions::Current_Dimensions.Border();
+	const float r = Field_Dimensions::Current_Dimensions.CenterRadius();
+	sidePolygon->vertices.push_back(Geometry2d::Point(-x, y1));
+	sidePolygon->vertices.push_back(Geometry2d::Point(-r, y1));
+	sidePolygon->vertices.push_back(Geometry2d::Point(0, y1 + r));
+	sidePolygon->vertices.push_back(Geometry2d::Point(r, y1));
+	sidePolygon->vertices.push_back(Geometry2d::Point(x, y1));
+	sidePolygon->vertices.push_back(Geometry2d::Point(x, y2));
+	sidePolygon->vertices.push_back(Geometry2d::Point(-x, y2));
+
+	float y = -Field_Dimensions::Current_Dimensions.Border();
+	float deadspace = Field_Dimensions::Current_Dimensions.Border();
+	x = Field_Dimensions::Current_Dimensions.FloorWidth() /2.0f;
+	Polygon* floorObstacle = new Polygon;
+	floorObstacle->vertices.push_back(Geometry2d::Point(-x, y));
+	floorObstacle->vertices.push_back(Geometry2d::Point(-x, y-1));
+	floorObstacle->vertices.push_back(Geometry2d::Point(x, y-1));
+	floorObstacle->vertices.push_back(Geometry2d::Point(x, y));
+	_nonFloor[0] = std::shared_ptr<Shape>(floorObstacle);
+
+	y = Field_Dimensions::Current_Dimensions.Length() + Field_Dimensions::Current_Dimensions.Border();
+	floorObstacle = new Polygon;
+	floorObstacle->vertices.push_back(Geometry2d::Point(-x, y));
+	floorObstacle->vertices.push_back(Geometry2d::Point(-x, y+1));
+	floorObstacle->vertices.push_back(Geometry2d::Point(x, y+1));
+	floorObstacle->vertices.push_back(Geometry2d::Point(x, y));
+	_nonFloor[1] = std::shared_ptr<Shape>(floorObstacle);
+
+	y = Field_Dimensions::Current_Dimensions.FloorLength();
+	floorObstacle = new Polygon;
+	floorObstacle->vertices.push_back(Geometry2d::Point(-x, -deadspace));
+	floorObstacle->vertices.push_back(Geometry2d::Point(-x-1, -deadspace));
+	floorObstacle->vertices.push_back(Geometry2d::Point(-x-1, y));
+	floorObstacle->vertices.push_back(Geometry2d::Point(-x, y));
+	_nonFloor[2] = std::shared_ptr<Shape>(floorObstacle);
+
+	floorObstacle = new Polygon;
+	floorObstacle->vertices.push_back(Geometry2d::Point(x, -deadspace));
+	floorObstacle->vertices.push_back(Geometry2d::Point(x+1, -deadspace));
+	floorObstacle->vertices.push_back(Geometry2d::Point(x+1, y));
+	floorObstacle->vertices.push_back(Geometry2d::Point(x, y));
+	_nonFloor[3] = std::shared_ptr<Shape>(floorObstacle);
+
+	Polygon* goalArea = new Polygon;
+	const float halfFlat = Field_Dimensions::Current_Dimensions.GoalFlat() /2.0;
+	const float radius = Field_Dimensions::Current_Dimensions.ArcRadius();
+	goalArea->vertices.push_back(Geometry2d::Point(-halfFlat, 0));
+	goalArea->vertices.push_back(Geometry2d::Point(-halfFlat, radius));
+	goalArea->vertices.push_back(Geometry2d::Point( halfFlat, radius));
+	goalArea->vertices.push_back(Geometry2d::Point( halfFlat, 0));
+	_goalArea.clear();
+	_goalArea.add(std::shared_ptr<Shape>(goalArea));
+	_goalArea.add(std::shared_ptr<Shape>(new Circle(Geometry2d::Point(-halfFlat, 0), radius)));
+	_goalArea.add(std::shared_ptr<Shape>(new Circle(Geometry2d::Point(halfFlat, 0), radius)));
+
+	_ourHalf = std::make_shared<Polygon>();
+	_ourHalf->vertices.push_back(Geometry2d::Point(-x, -Field_Dimensions::Current_Dimensions.Border()));
+	_ourHalf->vertices.push_back(Geometry2d::Point(-x, y1));
+	_ourHalf->vertices.push_back(Geometry2d::Point(x, y1));
+	_ourHalf->vertices.push_back(Geometry2d::Point(x, -Field_Dimensions::Current_Dimensions.Border()));
+
+	_opponentHalf = std::make_shared<Polygon>();
+	_opponentHalf->vertices.push_back(Geometry2d::Point(-x, y1));
+	_opponentHalf->vertices.push_back(Geometry2d::Point(-x, y2));
+	_opponentHalf->vertices.push_back(Geometry2d::Point(x, y2));
+	_opponentHalf->vertices.push_back(Geometry2d::Point(x, y1));
+
+	/// Each group of obstacles that is turned on and off together gets a distance field,
+	/// so most planning queries don't have to test the shapes themselves.
+	/// The fields cover the floor and the obstacles around it.
+	const Field_Dimensions &dims = Field_Dimensions::Current_Dimensions;
+	const Rect area(Geometry2d::Point(-dims.FloorWidth() / 2 - 1, -dims.Border() - 1),
+			Geometry2d::Point(dims.FloorWidth() / 2 + 1, dims.Length() + dims.Border() + 1));
+	const float cellSize = 0.05;
+
+	CompositeShape nonFloor;
+	for (const std::shared_ptr<Shape>& ptr :  _nonFloor)
+	{
+		nonFloor.add(ptr);
+	}
+
+	_sideField.build(*_sideObstacle, area, cellSize);
+	_ourHalfField.build(*_ourHalf, area, cellSize);
+	_opponentHalfField.build(*_opponentHalf, area, cellSize);
+	_nonFloorField.build(nonFloor, area, cellSize);
+	_goalAreaField.build(_goalArea, area, cellSize);
+}
+
+/**
+ * sets the field obstacles for this frame's planning
+ */
+void Gameplay::GameplayModule::updateStaticObstacles() {
+	_obstacles.clearStatic();
 	if (_state->gameState.stayOnSide())
 	{
-		obstacles.add(_sideObstacle);
+		_obstacles.addStatic(_sideObstacle, &_sideField);
 	}
 
 	if (!_state->logFrame->use_our_half())
 	{
-		obstacles.add(_ourHalf);
+		_obstacles.addStatic(_ourHalf, &_ourHalfField);
 	}
 
 	if (!_state->logFrame->use_opponent_half())
 	{
-		obstacles.add(_opponentHalf);
+		_obstacles.addStatic(_opponentHalf, &_opponentHalfField);
 	}
 
 	/// Add non floor obstacles
 	for (const std::shared_ptr<Shape>& ptr :  _nonFloor)
 	{
-		obstacles.add(ptr);
+		_obstacles.addStatic(ptr, &_nonFloorField);
+	}
+
+	/// The goalie is allowed in the goal area
+	for (const std::shared_ptr<Shape>& ptr :  _goalArea)
+	{
+		_obstacles.addStatic(ptr, &_goalAreaField, false);
 	}
-	return obstacles;
 }
 
 /**
@@ -242,6 +302,7 @@ void Gameplay::GameplayModule::run()
 		}
 	}
 
+	SpanTimer span;
 	PyGILState_STATE state = PyGILState_Ensure(); {
 		try {
 			//	vector of shared pointers to pass to python
@@ -305,24 +366,72 @@ void Gameplay::GameplayModule::run()
 	        throw new runtime_error("Error trying to run root play");
 	    }
 	} PyGILState_Release(state);
+	_state->logFrame->mutable_timing()->set_gameplay_python(span.lap());
 
 	/// determine global obstacles - field requirements
-	/// Two versions - one set with goal area, another without for goalie
-	Geometry2d::CompositeShape global_obstacles = globalObstacles();
-	Geometry2d::CompositeShape obstacles_with_goal = global_obstacles;
-	obstacles_with_goal.add(_goalArea);
+	/// The goal area is left out for the goalie.
+	/// These and the robots and ball are shared by every robot's planning.
+	updateStaticObstacles();
+	_obstacles.update(_state);
 
 	/// execute motion planning for each robot
+	/// Robots are planned independently, so each one is a separate task.
+	/// Tasks only draw into their own buffer and planners have their own random state.
+	_planningRobots.clear();
+	OurRobot *ballHandler = nullptr;
 	for (OurRobot* r :  _state->self) {
 		if (r && r->visible) {
-			/// set obstacles for the robots
-			if (r->shell() == _goalieID)
-				r->replanIfNeeded(global_obstacles); /// just for goalie
-			else
-				r->replanIfNeeded(obstacles_with_goal); /// all other robots
+			_planningRobots.push_back(r);
+			
+			if (_state->ball.valid && (!ballHandler || r->pos.distTo(_state->ball.pos) < ballHandler->pos.distTo(_state->ball.pos))) {
+				ballHandler = r;
+			}
 		}
 	}
 
+	/// Planning has a time budget for the frame.  The goalie and the robot nearest the ball
+	/// are planned first and get a bigger share.  Each robot's share starts when it does, so a
+	/// thread that finishes one robot early gives the time to the next, but nobody plans past
+	/// the end of the budget.
+	auto isPriority = [&](OurRobot *r) {
+		return r->shell() == _goalieID || r == ballHandler;
+	};
+	std::stable_partition(_planningRobots.begin(), _planningRobots.end(), isPriority);
+
+	const float budget = *_planningBudget * 1000;
+	const int threads = *_parallelPlanning ? _planningPool.workers() + 1 : 1;
+	float totalWeight = 0;
+	for (OurRobot *r : _planningRobots) {
+		totalWeight += isPriority(r) ? *_priorityPlanningWeight : 1;
+	}
+	_planningSlices.resize(_planningRobots.size());
+	for (size_t i = 0; i < _planningRobots.size(); ++i) {
+		float weight = isPriority(_planningRobots[i]) ? *_priorityPlanningWeight : 1;
+		_planningSlices[i] = min(budget, budget * threads * weight / totalWeight);
+	}
+	const Time planningDeadline = monotonicTimestamp() + (Time)budget;
+
+	std::function<void(int)> plan = [&](int i) {
+		OurRobot *r = _planningRobots[i];
+		SystemState::DrawRedirect redirect(&_planningDrawing[i]);
+		Time deadline = min(planningDeadline, monotonicTimestamp() + (Time)_planningSlices[i]);
+
+		r->replanIfNeeded(_obstacles, r->shell() == _goalieID, deadline);
+	};
+
+	if (*_parallelPlanning) {
+		_planningPool.run(_planningRobots.size(), plan);
+	} else {
+		for (size_t i = 0; i < _planningRobots.size(); ++i) {
+			plan(i);
+		}
+	}
+
+	for (size_t i = 0; i < _planningRobots.size(); ++i) {
+		_state->appendDrawing(_planningDrawing[i]);
+	}
+	_state->logFrame->mutable_timing()->set_gameplay_planning(span.lap());
+
 	/// visualize
 	if (_state->gameState.stayAwayFromBall() && _state->ball.valid)
 	{
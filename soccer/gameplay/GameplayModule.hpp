@@ -11,13 +11,22 @@
 #include <Geometry2d/CompositeShape.hpp>
 
 #include <set>
+#include <vector>
 #include <QMutex>
 #include <QString>
 
+#include <WorkerPool.hpp>
+#include <ObstacleCache.hpp>
+#include <planning/DistanceField.hpp>
+#include <protobuf/LogFrame.pb.h>
+
 #include <boost/ptr_container/ptr_vector.hpp>
 
 class OurRobot;
 class SystemState;
+class Configuration;
+class ConfigBool;
+class ConfigDouble;
 
 
 /**
@@ -41,6 +50,8 @@ namespace Gameplay
 			GameplayModule(SystemState *state);
 			virtual ~GameplayModule();
 			
+			static void createConfiguration(Configuration *cfg);
+			
 			SystemState *state() const
 			{
 				return _state;
@@ -102,6 +113,9 @@ namespace Gameplay
 
 			void sendFieldDimensionsToPython();
 
+			/// Rebuilds the field obstacles.  This must be called when the field dimensions change.
+			void updateFieldObstacles();
+
 
 		protected:
 
@@ -136,17 +150,49 @@ namespace Gameplay
 			///	goal area
 			Geometry2d::CompositeShape _goalArea;
 
+			/// Distance fields for the obstacles above, rebuilt with them
+			Planning::DistanceField _ourHalfField;
+			Planning::DistanceField _opponentHalfField;
+			Planning::DistanceField _sideField;
+			Planning::DistanceField _nonFloorField;
+			Planning::DistanceField _goalAreaField;
+
 			/// utility functions
 
 			/**
-			 * Returns the current set of global obstacles, including the field
+			 * Puts the field obstacles that apply to the current game state in _obstacles
 			 */
-			Geometry2d::CompositeShape globalObstacles() const;
+			void updateStaticObstacles();
+
+			/// Obstacles for this frame's planning, shared by all robots
+			ObstacleCache _obstacles;
 
 			int _our_score_last_frame;
 
 			// Shell ID of the robot to assign the goalie position
 			int _goalieID;
+			
+			/// If set, robots are planned on _planningPool instead of one after another
+			static ConfigBool *_parallelPlanning;
+			
+			/// Time allowed for planning all robots each frame, in milliseconds
+			static ConfigDouble *_planningBudget;
+			
+			/// How much more of the planning budget the goalie and the robot nearest the ball get
+			static ConfigDouble *_priorityPlanningWeight;
+			
+			/// Runs one path planning task per robot
+			WorkerPool _planningPool;
+			
+			/// Robots being planned this frame, indexed by task.  Priority robots come first.
+			std::vector<OurRobot *> _planningRobots;
+			
+			/// Planning time for each task, in microseconds
+			std::vector<float> _planningSlices;
+			
+			/// Debug drawing from each planning task, indexed by task.
+			/// This is added to the LogFrame in robot order after planning is done.
+			std::vector<Packet::LogFrame> _planningDrawing;
 
 
 			//	python
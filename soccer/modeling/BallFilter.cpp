@@ -13,7 +13,12 @@ BallFilter::BallFilter()
 {
 }
 
-void BallFilter::update(const BallObservation* obs)
+void BallFilter::reset()
+{
+	_estimate = Ball();
+}
+
+void BallFilter::update(const BallObservation* obs, const SystemState *state)
 {
 	if (_estimate.time)
 	{
@@ -7,18 +7,25 @@
 class Ball;
 class BallObservation;
 
-// A BallFilter never needs to reset itself.  The BallTracker will
-// create a new one when a new ball is found.
+// The BallTracker resets its filter when it starts following a different ball.
+//
+// This is a simple alpha filter on velocity.  See RbpfBallFilter for one that
+// follows kicks and deflections.
 class BallFilter
 {
 public:
 	BallFilter();
+	virtual ~BallFilter() {}
 	
-	// Gives a new observation to the filter
-	void update(const BallObservation *obs);
+	// Forgets the ball that was being followed
+	virtual void reset();
+	
+	// Gives a new observation to the filter.
+	// @state has the robots that the ball may run into.
+	virtual void update(const BallObservation *obs, const SystemState *state);
 	
 	// Generates a prediction of the ball's state at a given time in the future
-	void predict(Time time, Ball *out, float *velocityUncertainty);
+	virtual void predict(Time time, Ball *out, float *velocityUncertainty);
 	
 private:
 	Ball _estimate;
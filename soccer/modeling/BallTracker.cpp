@@ -1,42 +1,47 @@
 #include "BallTracker.hpp"
 #include "BallFilter.hpp"
+#include "RbpfBallFilter.hpp"
 
 #include <Utils.hpp>
 #include <Processor.hpp>
 #include <SystemState.hpp>
 
-#include <boost/make_shared.hpp>
+#include <algorithm>
 
 using namespace std;
-using namespace boost;
 using namespace Geometry2d;
 
-// Balls closer together than this will be removed
-static const float Distance_Limit = 0.2;
+// Standard deviation of vision measurements
+static const float Position_Noise = 0.01;
 
-// Maximum distance between observations on consecutive frames to
-// result in a possible acquisition.
-static const float Acquisition_Match_Distance = 0.5;
+// Spectral density of the random acceleration in each track's constant-velocity model.
+// This is large so a track keeps up with a kick instead of losing the ball.
+static const float Process_Noise = 1000;
 
-// Age of a track, in microseconds, at which is it dropped
-static const Time Drop_Possible_Track_Time = 500000;
-static const Time Drop_Real_Track_Time = 500000;
+// Velocity variance of a new track
+static const float Initial_Velocity_Var = 4;
 
-static const float Position_Uncertainty = 0.5;
+// Squared Mahalanobis distance within which an observation may belong to a track.
+// This is the 99.9% point of the chi-squared distribution with two degrees of freedom.
+static const float Gate = 13.8;
 
-// Quickly removes element <i> from a vector without the preserving order of later elements
-template<class T>
-void fastRemove(T &v, unsigned int i)
-{
-	assert(i < v.size());
-	int last = v.size() - 1;
-	swap(v[i], v[last]);
-	v.resize(last);
-}
+// Track scores
+static const float Initial_Score = 1;
+static const float Hit_Score = 1;		// Added when a track is seen
+static const float Miss_Score = 0.3;		// Taken off when vision arrives without it
+static const float Max_Score = 10;		// So an old track doesn't linger long after it's gone
+static const float Confirm_Score = 3;		// Confirmed after about three frames
+static const float Delete_Score = 0;
 
-BallTracker::BallTracker()
-{
-}
+// Age of a track, in microseconds, at which it is dropped no matter its score
+static const Time Drop_Track_Time = 500000;
+
+// Tracks faster than this are following noise.  A hard kick is about 8 m/s.
+static const float Max_Speed = 10;
+
+// Age at which an unconfirmed track is dropped.  Its gate grows quickly while it isn't
+// seen, so without this it would soon be confirmed by noise.
+static const Time Drop_Tentative_Time = 50000;
 
 void drawX(SystemState *state, Point center, const QColor &color = Qt::red)
 {
@@ -45,178 +50,333 @@ void drawX(SystemState *state, Point center, const QColor &color = Qt::red)
 	state->drawLine(center + Point(R, R), center + Point(-R, -R), color);
 }
 
-void BallTracker::run(const vector< BallObservation >& obs, SystemState *state)
+void BallTracker::Track::start(const BallObservation &o)
 {
-	unsigned int n = obs.size();
-	
-	vector<const BallObservation *> goodObs;
-	goodObs.resize(obs.size());
-	for (unsigned int i = 0; i < n; ++i)
+	active = true;
+	confirmed = false;
+	score = Initial_Score;
+	obs = o;
+	pos = o.pos;
+	vel = Point();
+	posVar = Position_Noise * Position_Noise;
+	posVelCov = 0;
+	velVar = Initial_Velocity_Var;
+}
+
+void BallTracker::Track::predict(Time time, Point &predicted, float &variance) const
+{
+	// Observations at the same time or a little out of order aren't moved
+	const float dt = max(0.0f, (float)((int64_t)(time - obs.time) * TimestampToSecs));
+	predicted = pos + vel * dt;
+	variance = posVar + 2 * dt * posVelCov + dt * dt * velVar + Process_Noise * dt * dt * dt / 3 + Position_Noise * Position_Noise;
+}
+
+void BallTracker::Track::update(const BallObservation &o)
+{
+	const float dt = max(0.0f, (float)((int64_t)(o.time - obs.time) * TimestampToSecs));
+	const float dt2 = dt * dt;
+
+	const float p00 = posVar + 2 * dt * posVelCov + dt2 * velVar + Process_Noise * dt2 * dt / 3;
+	const float p01 = posVelCov + dt * velVar + Process_Noise * dt2 / 2;
+	const float p11 = velVar + Process_Noise * dt;
+
+	const float s = p00 + Position_Noise * Position_Noise;
+	const float k0 = p00 / s;
+	const float k1 = p01 / s;
+
+	const Point predicted = pos + vel * dt;
+	const Point innovation = o.pos - predicted;
+	pos = predicted + innovation * k0;
+	vel += innovation * k1;
+
+	posVar = (1 - k0) * p00;
+	posVelCov = (1 - k0) * p01;
+	velVar = p11 - k1 * p01;
+
+	if (o.time > obs.time)
 	{
-		goodObs[i] = &obs[i];
+		obs = o;
 	}
-	
-#if 0
-	// Remove balls that are too close to other balls
-	if (n <= 20)
+}
+
+BallTracker::BallTracker():
+	_ballTrack(-1),
+	_newestTime(0),
+	_newestArrival(0),
+	_alphaFilter(new BallFilter()),
+	_ballFilter(0)
+{
+}
+
+BallTracker::~BallTracker()
+{
+}
+
+int BallTracker::numTracks() const
+{
+	int n = 0;
+	for (const Track &track : _tracks)
 	{
-		for (unsigned int i = 0; i < n; ++i)
+		n += track.active;
+	}
+	return n;
+}
+
+int BallTracker::numConfirmedTracks() const
+{
+	int n = 0;
+	for (const Track &track : _tracks)
+	{
+		n += track.active && track.confirmed;
+	}
+	return n;
+}
+
+void BallTracker::run(const vector< BallObservation >& obs, SystemState *state)
+{
+	const int numObs = min((int)obs.size(), (int)Max_Observations);
+
+	// Tracks are aged by camera time, so vision latency doesn't count against them.
+	// Between observations the camera clock is assumed to keep up with ours.
+	const Time arrival = timestamp();
+	for (int o = 0; o < numObs; ++o)
+	{
+		if (obs[o].time > _newestTime)
 		{
-			for (unsigned int j = 0; j < n; ++j)
-			{
-				if (i != j && (goodObs[i] || goodObs[j]))
-				{
-					if (obs[i].pos.nearPoint(obs[j].pos, Distance_Limit))
-					{
-						// Balls are too close together: remove them both
-						if (goodObs[i])
-						{
-							drawX(state, obs[i].pos);
-							goodObs[i] = 0;
-						}
-						if (goodObs[j])
-						{
-							drawX(state, obs[j].pos);
-							goodObs[j] = 0;
-						}
-					}
-				}
-			}
+			_newestTime = obs[o].time;
+			_newestArrival = arrival;
 		}
-		
-		// Remove null entries from goodObs, not preserving order
-		for (unsigned int i = 0; i < goodObs.size(); ++i)
+	}
+	const Time now = _newestTime + (arrival - _newestArrival);
+
+	// Tracks that haven't been seen for too long are dropped before gating,
+	// since by now their gates could take in anything
+	for (int t = 0; t < Max_Tracks; ++t)
+	{
+		const Track &track = _tracks[t];
+		const int64_t age = now - track.obs.time;
+		if (track.active && age >= (int64_t)(track.confirmed ? Drop_Track_Time : Drop_Tentative_Time))
 		{
-			if (goodObs[i] == 0)
-			{
-				fastRemove(goodObs, i);
-				--i;
-			}
+			drop(t);
 		}
 	}
-#endif
 
-	Time now = timestamp();
-	
-	//FIXME - What time?
-	Time predictTime = now;
-	
 	// Rectangle that defines the boundaries of the field.
 	// Note that we are working in team space.
 	const Rect field(Point(-Field_Dimensions::Current_Dimensions.Width() / 2, 0), Point(Field_Dimensions::Current_Dimensions.Width() / 2, Field_Dimensions::Current_Dimensions.Length()));
-	
-	// Update the real ball
-	if (_ballFilter)
+
+	// Gate every observation against every track
+	bool inGate[Max_Observations] = {false};
+	int numPairs = 0;
+	for (int t = 0; t < Max_Tracks; ++t)
 	{
-		// Get a prediction for this frame from the filter
-		Ball prediction;
-		float velocityUncertainty = 0;
-		_ballFilter->predict(predictTime, &prediction, &velocityUncertainty);
-		
-		Point windowCenter = prediction.pos;
-		float windowRadius = Position_Uncertainty + velocityUncertainty * (predictTime - _lastTrackTime) / 1000000.0f;
-		state->drawCircle(windowCenter, windowRadius, Qt::white);
-		
-		// Find the closest new observation to the real ball's predicted position
-		float bestDist = -1;
-		unsigned int best = 0;
-		for (unsigned int i = 0; i < goodObs.size(); ++i)
-		{
-			float d = goodObs[i]->pos.distTo(windowCenter);
-			if (goodObs[i]->time > _lastTrackTime && d <= windowRadius && (bestDist < 0 || d < bestDist))
+		if (!_tracks[t].active)
+		{
+			continue;
+		}
+
+		for (int o = 0; o < numObs; ++o)
+		{
+			Point predicted;
+			float variance;
+			_tracks[t].predict(obs[o].time, predicted, variance);
+
+			const float d2 = (obs[o].pos - predicted).magsq() / variance;
+			if (d2 < Gate)
 			{
-				bestDist = d;
-				best = i;
+				// Negative log likelihood, less the constant, so tracks with different
+				// uncertainty can be compared
+				Pair &pair = _pairs[numPairs++];
+				pair.cost = d2 / 2 + logf(variance);
+				pair.track = t;
+				pair.obs = o;
+				inGate[o] = true;
 			}
 		}
-		
-		if (bestDist >= 0)
+	}
+
+	// Global nearest neighbor: the cheapest pairs are taken first, and each track and
+	// observation is used at most once.  This is greedy rather than an optimal assignment,
+	// which only differs when gates overlap and is much cheaper.
+	sort(_pairs, _pairs + numPairs);
+	int assigned[Max_Tracks];
+	bool used[Max_Observations] = {false};
+	for (int t = 0; t < Max_Tracks; ++t)
+	{
+		assigned[t] = -1;
+	}
+	for (int i = 0; i < numPairs; ++i)
+	{
+		const Pair &pair = _pairs[i];
+		if (assigned[pair.track] < 0 && !used[pair.obs])
+		{
+			assigned[pair.track] = pair.obs;
+			used[pair.obs] = true;
+		}
+	}
+
+	// Update tracks and their scores
+	for (int t = 0; t < Max_Tracks; ++t)
+	{
+		Track &track = _tracks[t];
+		if (!track.active)
 		{
-			// Update the filter
-			_ballFilter->update(goodObs[best]);
-			_lastTrackTime = goodObs[best]->time;
-			
-			// Update the real track
-			_ballFilter->predict(state->logFrame->command_time(), &state->ball, 0);
-			
-			// Don't use this observation for a possible track since it's the real track
-			fastRemove(goodObs, best);
+			continue;
 		}
-		
-		// If we haven't found an update in a long time, drop the real ball track
-		if ((now - _lastTrackTime) >= Drop_Real_Track_Time)
+
+		if (assigned[t] >= 0)
 		{
-			_ballFilter.reset();
-			state->ball.valid = false;
+			track.update(obs[assigned[t]]);
+			track.score = min(Max_Score, track.score + Hit_Score);
+			if (track.score >= Confirm_Score)
+			{
+				track.confirmed = true;
+			}
+		} else if (numObs)
+		{
+			track.score -= Miss_Score;
+		}
+
+		if (track.score < Delete_Score || track.vel.magsq() > Max_Speed * Max_Speed)
+		{
+			drop(t);
 		}
-	} else {
-		state->ball.valid = false;
 	}
-	
-	// Update possible tracks
-	for (unsigned int i = 0; i < _possibleTracks.size(); ++i)
+
+	// Tracks that have come together are following the same thing, as when one picks up
+	// a second camera's view of another.  The weaker one is dropped.
+	for (int t = 0; t < Max_Tracks; ++t)
 	{
-		// Find the closest new observation to this track which is within Acquisition_Match_Distance
-		float bestDist = -1;
-		unsigned int best = 0;
-		for (unsigned int j = 0; j < goodObs.size(); ++j)
+		for (int u = t + 1; u < Max_Tracks && _tracks[t].active; ++u)
 		{
-			float d = goodObs[j]->pos.distTo(_possibleTracks[i].obs.pos);
-			if (field.contains(goodObs[j]->pos) && d <= Acquisition_Match_Distance && (bestDist < 0 || d < bestDist))
+			Track &a = _tracks[t];
+			Track &b = _tracks[u];
+			if (b.active && (a.pos - b.pos).magsq() / (a.posVar + b.posVar) < Gate)
 			{
-				bestDist = d;
-				best = j;
+				const bool keepA = (t == _ballTrack) || (u != _ballTrack && a.score >= b.score);
+				drop(keepA ? u : t);
 			}
 		}
-		
-		if (bestDist >= 0)
-		{
-			// Update this track
-			_possibleTracks[i].current = true;
-			_possibleTracks[i].obs = *goodObs[best];
-			++_possibleTracks[i].numFrames;
-			
-			// Remove from goodObs
-			fastRemove(goodObs, best);
-			
-			drawX(state, _possibleTracks[i].obs.pos, Qt::yellow);
-		} else {
-			_possibleTracks[i].current = false;
-		}
-		
-		if ((now - _possibleTracks[i].obs.time) >= Drop_Possible_Track_Time)
+
+		if (_tracks[t].active && !_tracks[t].confirmed)
 		{
-			fastRemove(_possibleTracks, i);
-			--i;
+			drawX(state, _tracks[t].pos, Qt::yellow);
 		}
 	}
-	
-	// Any remaining observations will start new tracks
-	for (unsigned int i = 0; i < goodObs.size(); ++i)
+
+	// Observations that aren't near any track start new ones.
+	// Unassigned observations inside a gate are the same ball seen by another camera.
+	int started[Max_Tracks];
+	int numStarted = 0;
+	for (int o = 0; o < numObs; ++o)
 	{
-		if (field.contains(goodObs[i]->pos))
+		if (inGate[o] || !field.contains(obs[o].pos))
+		{
+			continue;
+		}
+
+		// A ball that several cameras saw for the first time only gets one track
+		bool duplicate = false;
+		for (int i = 0; i < numStarted && !duplicate; ++i)
 		{
-			_possibleTracks.push_back(PossibleTrack(*goodObs[i]));
+			Point predicted;
+			float variance;
+			_tracks[started[i]].predict(obs[o].time, predicted, variance);
+			duplicate = (obs[o].pos - predicted).magsq() / variance < Gate;
+		}
+		if (duplicate)
+		{
+			continue;
+		}
+
+		// An empty slot, or else the weakest unconfirmed track that has been missed since it started
+		int slot = -1;
+		for (int t = 0; t < Max_Tracks; ++t)
+		{
+			const Track &track = _tracks[t];
+			if (!track.active)
+			{
+				slot = t;
+				break;
+			}
+
+			if (!track.confirmed && track.score < Initial_Score && (slot < 0 || track.score < _tracks[slot].score))
+			{
+				slot = t;
+			}
+		}
+
+		if (slot >= 0)
+		{
+			_tracks[slot].start(obs[o]);
+			assigned[slot] = -1;
+			started[numStarted++] = slot;
 		}
 	}
-	
-	// Try to acquire the real ball
-	if (!_ballFilter)
+
+	updateBall(assigned, obs, state);
+}
+
+void BallTracker::drop(int t)
+{
+	_tracks[t].active = false;
+	if (t == _ballTrack)
+	{
+		// The slot may be reused by a new track this frame, which must be confirmed
+		// on its own before it can be the ball
+		_ballTrack = -1;
+	}
+}
+
+void BallTracker::updateBall(const int *assigned, const vector<BallObservation> &obs, SystemState *state)
+{
+	if (_ballTrack >= 0 && !(_tracks[_ballTrack].active && _tracks[_ballTrack].confirmed))
+	{
+		_ballTrack = -1;
+	}
+
+	if (_ballTrack < 0)
 	{
-		for (unsigned int i = 0; i < _possibleTracks.size(); ++i)
+		// Take the most likely confirmed track
+		for (int t = 0; t < Max_Tracks; ++t)
 		{
-			if (_possibleTracks[i].current && _possibleTracks[i].numFrames >= 3)
+			const Track &track = _tracks[t];
+			if (track.active && track.confirmed && (_ballTrack < 0 || track.score > _tracks[_ballTrack].score))
 			{
-				_ballFilter = std::make_shared<BallFilter>();
-				
-				// First update and prediction
-				_ballFilter->update(&_possibleTracks[i].obs);
-				_lastTrackTime = _possibleTracks[i].obs.time;
-				_ballFilter->predict(state->logFrame->command_time(), &state->ball, 0);
-				
-				fastRemove(_possibleTracks, i);
-				break;
+				_ballTrack = t;
+			}
+		}
+
+		if (_ballTrack < 0)
+		{
+			state->ball.valid = false;
+			return;
+		}
+
+		// Start following the new ball from its latest observation.
+		// The filters are reused, unless the particle count has changed.
+		if (RbpfBallFilter::enabled())
+		{
+			if (!_rbpf || _rbpf->numParticles() != RbpfBallFilter::configuredParticles())
+			{
+				_rbpf.reset(new RbpfBallFilter());
 			}
+			_ballFilter = _rbpf.get();
+		} else {
+			_ballFilter = _alphaFilter.get();
 		}
+		_ballFilter->reset();
+		_ballFilter->update(&_tracks[_ballTrack].obs, state);
+	} else if (assigned[_ballTrack] >= 0)
+	{
+		_ballFilter->update(&obs[assigned[_ballTrack]], state);
 	}
+
+	// Show where the next observation of the ball will be looked for
+	Point predicted;
+	float variance;
+	_tracks[_ballTrack].predict(timestamp(), predicted, variance);
+	state->drawCircle(predicted, sqrtf(Gate * variance), Qt::white);
+
+	_ballFilter->predict(state->logFrame->command_time(), &state->ball, 0);
 }
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include <Geometry2d/Point.hpp>
 #include <Utils.hpp>
 
 
 class BallFilter;
+class RbpfBallFilter;
 class SystemState;
 
 class BallObservation
@@ -20,32 +22,104 @@ public:
 	Time time;
 };
 
+/**
+ * @brief Finds the real ball among the balls seen by vision
+ *
+ * @details
+ * Every ball-like thing that vision reports is followed by a track with a small
+ * constant-velocity Kalman filter.  Each frame, observations are gated against the
+ * tracks by Mahalanobis distance from their predicted positions, and the gated pairs
+ * are assigned globally nearest first, so each track gets at most one observation and
+ * each observation goes to at most one track.  Observations in a track's gate that
+ * weren't assigned are duplicates from overlapping cameras and are dropped.  The rest
+ * start new tracks.
+ *
+ * Tracks have a score that goes up when they are seen and down when they aren't.
+ * A track is confirmed once its score is high enough and deleted when it falls too
+ * low, so one-off false positives (orange shirts, reflections) never get confirmed.
+ * Tracks that move impossibly fast or come together with a stronger track are dropped.
+ * The real ball is the best confirmed track, and it alone goes through the BallFilter.
+ *
+ * Tracks are kept in a fixed-size pool and only so many observations are considered
+ * per frame, so the cost is bounded no matter how much clutter vision reports.
+ * Nothing is allocated after construction unless the ball filter's configuration changes.
+ */
 class BallTracker
 {
 public:
+	/// Tracks followed at once.  When the pool is full, the weakest unconfirmed track is replaced.
+	static const int Max_Tracks = 16;
+	
+	/// Observations considered per run.  Any more are ignored.
+	static const int Max_Observations = 64;
+	
 	BallTracker();
+	~BallTracker();
 	
 	void run(const std::vector<BallObservation> &obs, SystemState *state);
+	
+	/// Number of tracks being followed, confirmed or not
+	int numTracks() const;
+	
+	/// Number of tracks that have been confirmed
+	int numConfirmedTracks() const;
 
 private:
-	/// Time of the last observation given to the filter
-	Time _lastTrackTime;
-	
-	/// Possible balls that were not used on the last frame
-	struct PossibleTrack
+	struct Track
 	{
-		PossibleTrack(): current(false), numFrames(0) {}
-		PossibleTrack(const BallObservation &obs): current(true), numFrames(1), obs(obs) {}
+		Track(): active(false) {}
 		
-		/// True if this track was seen in the most recent set of vision observations
-		bool current;
-		
-		/// Number of frames over which we have been following this track
-		int numFrames;
+		bool active;
+		bool confirmed;
+		float score;
 		
+		/// Last observation applied to this track
 		BallObservation obs;
+		
+		/// Filtered position and velocity at obs.time, and their covariance,
+		/// which is the same on both axes
+		Geometry2d::Point pos, vel;
+		float posVar, posVelCov, velVar;
+		
+		void start(const BallObservation &obs);
+		
+		/// Predicts the position at @time and the variance of an observation there
+		void predict(Time time, Geometry2d::Point &predicted, float &variance) const;
+		
+		void update(const BallObservation &obs);
 	};
-	std::vector<PossibleTrack> _possibleTracks;
 	
-	std::shared_ptr<BallFilter> _ballFilter;
-};
\ No newline at end of file
+	/// A gated observation and track, with the cost of assigning one to the other
+	struct Pair
+	{
+		float cost;
+		short track;
+		short obs;
+		
+		bool operator<(const Pair &other) const
+		{
+			return cost < other.cost;
+		}
+	};
+	
+	/// Deactivates a track, and forgets the ball if it was that track
+	void drop(int t);
+	
+	/// Chooses the real ball if there isn't one and updates its filter
+	void updateBall(const int *assigned, const std::vector<BallObservation> &obs, SystemState *state);
+	
+	Track _tracks[Max_Tracks];
+	Pair _pairs[Max_Tracks * Max_Observations];
+	
+	/// Track that is the real ball, or -1
+	int _ballTrack;
+	
+	/// Camera time of the newest observation, and our time when it arrived
+	Time _newestTime;
+	Time _newestArrival;
+	
+	/// Filters for the real ball.  _ballFilter is the one being used.
+	std::unique_ptr<BallFilter> _alphaFilter;
+	std::unique_ptr<RbpfBallFilter> _rbpf;
+	BallFilter *_ballFilter;
+};
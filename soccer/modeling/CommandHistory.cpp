@@ -0,0 +1,178 @@
+#include "CommandHistory.hpp"
+#include <Utils.hpp>
+#include <Constants.hpp>
+
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+using namespace Geometry2d;
+
+// A command is only considered in effect for this long after it was sent.
+// Robots that aren't visible don't get commands, so a gap means nobody was driving it.
+static const Time Max_Command_Age = 100000;
+
+// Observations only say something about latency if the robot was told to move
+static const float Min_Command_Speed = 0.2;		// m/s
+static const float Min_Command_Angle_Vel = 1;		// rad/s
+
+// Weight of each new observation in the running latency errors
+static const float Error_Gain = 0.02;
+
+// Observations needed before the estimate is used
+static const int Min_Latency_Samples = 60;
+
+// Longest step taken when following commands
+static const Time Max_Step = 5000;
+
+CommandHistory::CommandHistory()
+{
+	for (unsigned int s = 0; s < Num_Shells; ++s)
+	{
+		_next[s] = 0;
+		_count[s] = 0;
+		_lastObserved[s] = 0;
+	}
+
+	for (int i = 0; i < Num_Latencies; ++i)
+	{
+		_latencyError[i] = 0;
+	}
+	_latencySamples = 0;
+}
+
+void CommandHistory::add(unsigned int shell, Time time, const Point &bodyVel, float angleVel)
+{
+	if (shell >= Num_Shells)
+	{
+		return;
+	}
+
+	Command &cmd = _commands[shell][_next[shell]];
+	cmd.time = time;
+	cmd.bodyX = bodyVel.x;
+	cmd.bodyY = bodyVel.y;
+	cmd.angleVel = angleVel;
+
+	_next[shell] = (_next[shell] + 1) % Size;
+	if (_count[shell] < Size)
+	{
+		++_count[shell];
+	}
+}
+
+const CommandHistory::Command *CommandHistory::commandAt(unsigned int shell, Time time) const
+{
+	// Newest first, since recent times are the ones that are asked for
+	for (int i = 1; i <= _count[shell]; ++i)
+	{
+		const Command &cmd = _commands[shell][(_next[shell] - i + Size) % Size];
+		if (cmd.time <= time)
+		{
+			return (time - cmd.time <= Max_Command_Age) ? &cmd : nullptr;
+		}
+	}
+
+	return nullptr;
+}
+
+void CommandHistory::observe(unsigned int shell, Time time, const RobotPose &pose)
+{
+	if (shell >= Num_Shells || time <= _lastObserved[shell])
+	{
+		return;
+	}
+	_lastObserved[shell] = time;
+
+	// What the robot was actually doing, in the same frame as its commands
+	const Point bodyVel = pose.vel.rotated(-pose.angle);
+
+	const Command *cmds[Num_Latencies];
+	bool moving = false;
+	for (int i = 0; i < Num_Latencies; ++i)
+	{
+		cmds[i] = commandAt(shell, time - i * Latency_Step);
+		if (!cmds[i])
+		{
+			// Not controlled over the whole range
+			return;
+		}
+
+		if (Point(cmds[i]->bodyX, cmds[i]->bodyY).mag() > Min_Command_Speed ||
+			fabsf(cmds[i]->angleVel) > Min_Command_Angle_Vel)
+		{
+			moving = true;
+		}
+	}
+
+	if (!moving)
+	{
+		// Every latency matches a robot that is sitting still
+		return;
+	}
+
+	for (int i = 0; i < Num_Latencies; ++i)
+	{
+		// Angular velocity is weighted by how fast it moves the edge of the robot
+		const float dw = (pose.angleVel - cmds[i]->angleVel) * Robot_Radius;
+		const float err = (bodyVel - Point(cmds[i]->bodyX, cmds[i]->bodyY)).magsq() + dw * dw;
+
+		if (_latencySamples)
+		{
+			_latencyError[i] += Error_Gain * (err - _latencyError[i]);
+		} else {
+			_latencyError[i] = err;
+		}
+	}
+	++_latencySamples;
+}
+
+Time CommandHistory::latency(Time defaultLatency) const
+{
+	if (_latencySamples < Min_Latency_Samples)
+	{
+		return defaultLatency;
+	}
+
+	return (min_element(_latencyError, _latencyError + Num_Latencies) - _latencyError) * Latency_Step;
+}
+
+void CommandHistory::predict(unsigned int shell, Time from, Time to, Time latency, RobotPose &pose) const
+{
+	if (shell >= Num_Shells)
+	{
+		return;
+	}
+
+	Point pos = pose.pos;
+	Point vel = pose.vel;
+	float angle = pose.angle;
+	float angleVel = pose.angleVel;
+
+	for (Time t = from; t < to;)
+	{
+		const Time end = min(to, t + Max_Step);
+		const float dt = (end - t) * TimestampToSecs;
+
+		const Command *cmd = commandAt(shell, t - latency);
+		if (cmd)
+		{
+			// Rotate the body velocity by the angle halfway through the step
+			const Point bodyVel(cmd->bodyX, cmd->bodyY);
+			pos += bodyVel.rotated(angle + cmd->angleVel * dt / 2) * dt;
+			angle += cmd->angleVel * dt;
+			vel = bodyVel.rotated(angle);
+			angleVel = cmd->angleVel;
+		} else {
+			pos += vel * dt;
+			angle += angleVel * dt;
+		}
+
+		t = end;
+	}
+
+	pose.pos = pos;
+	pose.vel = vel;
+	pose.angle = fixAngleRadians(angle);
+	pose.angleVel = angleVel;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Robot.hpp>
+
+/**
+ * @brief Recent velocity commands sent to our robots
+ *
+ * @details
+ * Vision is always some time behind, and a command takes some time to have an
+ * effect, but we know what we told our robots to do in between.  Each robot's
+ * filtered state at its last observation is moved forward to the time a new
+ * command will take effect by following the commands that will be in effect over
+ * that span, instead of assuming the robot keeps its measured velocity.
+ *
+ * The effective latency (radio, firmware, and motors together) is estimated
+ * online by comparing the velocities seen by vision with the commands that were
+ * sent at a range of times before each observation.  The delay whose commands
+ * best match what the robots actually did is used.
+ *
+ * All velocities here are in physical units: m/s in the robot's body frame and rad/s.
+ */
+class CommandHistory
+{
+public:
+	/// Commands kept per robot, about a second at 60 Hz
+	static const int Size = 64;
+
+	/// Latencies that are considered by the estimate: multiples of Latency_Step up to Num_Latencies - 1 of them
+	static const int Num_Latencies = 21;
+	static const Time Latency_Step = 10000;
+
+	CommandHistory();
+
+	/// Records a command sent to @shell at @time
+	void add(unsigned int shell, Time time, const Geometry2d::Point &bodyVel, float angleVel);
+
+	/// Updates the latency estimate with @shell's filtered state at the time it was last seen.
+	/// Observations older than the last one given for @shell are ignored.
+	void observe(unsigned int shell, Time time, const RobotPose &pose);
+
+	/// Moves @pose, which is @shell's state at @from, forward to @to by following the commands
+	/// that were in effect over that time, each starting @latency after it was sent.
+	/// Where there are no commands (the robot wasn't being controlled), the pose's own velocity is used.
+	void predict(unsigned int shell, Time from, Time to, Time latency, RobotPose &pose) const;
+
+	/// Estimated time from sending a command to the robot following it.
+	/// This is @defaultLatency until enough observations of moving robots have been seen.
+	Time latency(Time defaultLatency) const;
+
+private:
+	struct Command
+	{
+		Time time;
+		float bodyX, bodyY;
+		float angleVel;
+	};
+
+	/// Returns the command that was in effect at @time (the last one sent before it),
+	/// or null if there wasn't a recent one.
+	const Command *commandAt(unsigned int shell, Time time) const;
+
+	/// Ring buffer of each robot's commands.  _next is where the next command goes.
+	Command _commands[Num_Shells][Size];
+	int _next[Num_Shells];
+	int _count[Num_Shells];
+
+	/// Time of the last observation given to observe() for each robot
+	Time _lastObserved[Num_Shells];
+
+	/// Running mean squared difference between observed and commanded velocity for each latency
+	float _latencyError[Num_Latencies];
+
+	/// Number of observations that have gone into _latencyError
+	int _latencySamples;
+};
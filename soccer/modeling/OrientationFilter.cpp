@@ -0,0 +1,175 @@
+#include "OrientationFilter.hpp"
+
+#include <math.h>
+
+using namespace std;
+
+// Standard deviation of vision angle measurements
+static const float Angle_Noise = 0.05;			// rad
+
+// Rate at which the IMU heading drifts away from the field, as a random walk
+static const float Offset_Drift = 0.001;		// rad^2/s
+
+// A vision angle this far from the IMU's is more likely a reset of the IMU
+// (or a change of sides) than drift, so the offset starts over.
+static const float Max_Innovation = 0.5;		// rad
+
+// The latest IMU sample is only used for this long, which covers the command latency
+static const float Max_Age = 0.15;			// s
+
+// Vision a little newer than the latest IMU sample uses that sample
+static const float Max_Extrapolation = 0.03;		// s
+
+// Angular velocity is measured over at least this long, since the IMU heading is quantized
+static const float Rate_Span = 0.03;			// s
+
+OrientationFilter::OrientationFilter()
+{
+	for (RobotState &r : _robots)
+	{
+		r.next = 0;
+		r.count = 0;
+		r.offset = 0;
+		r.offsetVar = 0;
+		r.visionTime = 0;
+	}
+}
+
+float OrientationFilter::yaw(float w, float x, float y, float z)
+{
+	// Both terms scale with the square of the quaternion's magnitude
+	return atan2f(2 * (w * z + x * y), w * w + x * x - y * y - z * z);
+}
+
+void OrientationFilter::imu(unsigned int shell, Time time, float yaw)
+{
+	if (shell >= Num_Shells)
+	{
+		return;
+	}
+
+	RobotState &r = _robots[shell];
+	if (r.count && time <= r.sample(0).time)
+	{
+		// Duplicate or out of order
+		return;
+	}
+
+	Sample &s = r.samples[r.next];
+	s.time = time;
+	s.yaw = yaw;
+	r.next = (r.next + 1) % History_Size;
+	if (r.count < History_Size)
+	{
+		++r.count;
+	}
+}
+
+bool OrientationFilter::yawAt(const RobotState &r, Time time, float &yaw)
+{
+	if (!r.count)
+	{
+		return false;
+	}
+
+	const Sample &newest = r.sample(0);
+	if (time >= newest.time)
+	{
+		if ((time - newest.time) * TimestampToSecs > Max_Extrapolation)
+		{
+			return false;
+		}
+		yaw = newest.yaw;
+		return true;
+	}
+
+	for (int n = 1; n < r.count; ++n)
+	{
+		const Sample &before = r.sample(n);
+		if (before.time <= time)
+		{
+			const Sample &after = r.sample(n - 1);
+			const float f = (float)(time - before.time) / (after.time - before.time);
+			yaw = fixAngleRadians(before.yaw + f * fixAngleRadians(after.yaw - before.yaw));
+			return true;
+		}
+	}
+
+	// Older than the history
+	return false;
+}
+
+void OrientationFilter::vision(unsigned int shell, Time time, float angle)
+{
+	if (shell >= Num_Shells)
+	{
+		return;
+	}
+
+	RobotState &r = _robots[shell];
+	float imuYaw;
+	if (!yawAt(r, time, imuYaw))
+	{
+		return;
+	}
+
+	const float R = Angle_Noise * Angle_Noise;
+	const float z = fixAngleRadians(angle - imuYaw);
+
+	// Late observations are applied to the offset as of their own time.  The offset
+	// changes slowly, so one that arrives out of order just doesn't add any drift.
+	if (r.visionTime && time > r.visionTime)
+	{
+		r.offsetVar += Offset_Drift * (time - r.visionTime) * TimestampToSecs;
+	}
+
+	const float innovation = fixAngleRadians(z - r.offset);
+	if (r.offsetVar == 0 || fabsf(innovation) > Max_Innovation)
+	{
+		r.offset = z;
+		r.offsetVar = R;
+	} else {
+		const float k = r.offsetVar / (r.offsetVar + R);
+		r.offset = fixAngleRadians(r.offset + k * innovation);
+		r.offsetVar *= 1 - k;
+	}
+
+	r.visionTime = max(r.visionTime, time);
+}
+
+bool OrientationFilter::predict(unsigned int shell, Time time, float &angle, float &angleVel) const
+{
+	if (shell >= Num_Shells)
+	{
+		return false;
+	}
+
+	const RobotState &r = _robots[shell];
+	if (!r.count || r.offsetVar == 0)
+	{
+		return false;
+	}
+
+	const Sample &newest = r.sample(0);
+	const float age = (int64_t)(time - newest.time) * TimestampToSecs;
+	if (age > Max_Age)
+	{
+		return false;
+	}
+
+	float w = 0;
+	for (int n = 1; n < r.count; ++n)
+	{
+		const Sample &older = r.sample(n);
+		const float dt = (newest.time - older.time) * TimestampToSecs;
+		if (dt >= Rate_Span || n == r.count - 1)
+		{
+			w = fixAngleRadians(newest.yaw - older.yaw) / dt;
+			break;
+		}
+	}
+
+	angle = fixAngleRadians(newest.yaw + r.offset + w * age);
+	angleVel = w;
+	return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Utils.hpp>
+#include <Constants.hpp>
+
+/**
+ * @brief Combines our robots' on-board orientation with vision
+ *
+ * @details
+ * Robots with an IMU report their orientation in every radio packet, which is
+ * much more often and with less delay than vision.  The IMU's heading has an
+ * arbitrary zero (wherever the robot was pointing when it started) and drifts
+ * slowly, so it is only useful once it has been related to field coordinates.
+ *
+ * For each robot, this keeps a Kalman filter on the offset from IMU heading to
+ * vision angle, which is treated as a slow random walk.  Each vision observation
+ * is compared with the IMU heading at the time the frame was captured, looked up in
+ * a short history of radio samples, so it doesn't matter that vision arrives late or
+ * out of order.  The current angle is then the latest IMU heading plus the offset,
+ * and angular velocity comes from the IMU alone.
+ *
+ * The IMU is assumed to be mounted right side up.  Its rotation about the vertical
+ * axis doesn't matter, since that is part of the offset.
+ *
+ * Wheel encoders could be used the same way for velocity, but they aren't decoded
+ * from radio packets yet.
+ */
+class OrientationFilter
+{
+public:
+	/// Radio samples kept per robot.  This must cover the vision latency.
+	static const int History_Size = 32;
+
+	OrientationFilter();
+
+	/// Heading in radians about the vertical axis from an orientation quaternion.
+	/// The quaternion doesn't need to be normalized.
+	static float yaw(float w, float x, float y, float z);
+
+	/// Adds an on-board heading reported by @shell at @time.
+	/// Samples must be added in order.
+	void imu(unsigned int shell, Time time, float yaw);
+
+	/// Corrects @shell's heading offset with its angle seen by vision at @time
+	void vision(unsigned int shell, Time time, float angle);
+
+	/// Sets @shell's angle and angular velocity at @time from its latest IMU sample.
+	/// Returns false and leaves them unchanged if there is no recent sample or it hasn't
+	/// been related to vision yet.
+	bool predict(unsigned int shell, Time time, float &angle, float &angleVel) const;
+
+private:
+	struct Sample
+	{
+		Time time;
+		float yaw;
+	};
+
+	struct RobotState
+	{
+		/// Ring buffer of IMU samples.  next is where the next sample goes.
+		Sample samples[History_Size];
+		int next;
+		int count;
+
+		/// Vision angle minus IMU heading, and its variance.  Zero variance means it hasn't been set.
+		float offset;
+		float offsetVar;
+
+		/// Time of the vision observation that was last applied to offset
+		Time visionTime;
+
+		/// The @n'th most recent sample
+		const Sample &sample(int n) const
+		{
+			return samples[(next - 1 - n + History_Size) % History_Size];
+		}
+	};
+
+	/// IMU heading of @r at @time, interpolated between samples.
+	/// Returns false if @time isn't covered by the history.
+	static bool yawAt(const RobotState &r, Time time, float &yaw);
+
+	RobotState _robots[Num_Shells];
+};
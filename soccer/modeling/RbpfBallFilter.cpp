@@ -0,0 +1,263 @@
+#include "RbpfBallFilter.hpp"
+#include "BallTracker.hpp"
+
+#include <SystemState.hpp>
+#include <Robot.hpp>
+#include <Constants.hpp>
+
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+using namespace Geometry2d;
+
+REGISTER_CONFIGURABLE(RbpfBallFilter)
+
+ConfigBool *RbpfBallFilter::_enabled;
+ConfigInt *RbpfBallFilter::_particleCount;
+
+// Standard deviation of vision measurements
+static const float Position_Noise = 0.01;		// m
+
+// Velocity variance when the ball is first seen
+static const float Initial_Velocity_Var = 4;		// (m/s)^2
+
+// Spectral density of the random acceleration while rolling
+static const float Rolling_Process_Noise = 0.5;	// m^2/s^3
+
+// Deceleration from rolling friction on carpet
+static const float Rolling_Deceleration = 0.4;		// m/s^2
+
+// Velocity variance added by a kick or deflection.  A hard kick is about 8 m/s.
+static const float Kick_Velocity_Var = 36;		// (m/s)^2
+
+// Chance of a kick between observations, away from and next to a robot
+static const float Kick_Probability = 0.01;
+static const float Near_Kick_Probability = 0.3;
+
+// Distance from a robot's center within which the ball may be kicked or deflected by it
+static const float Kick_Distance = Robot_Radius + Ball_Radius + 0.05;
+
+void RbpfBallFilter::createConfiguration(Configuration *cfg)
+{
+	_enabled = new ConfigBool(cfg, "Ball Filter/RBPF", true);
+	_particleCount = new ConfigInt(cfg, "Ball Filter/Particles", 64);
+}
+
+int RbpfBallFilter::configuredParticles()
+{
+	return max(1, min((int)*_particleCount, (int)Max_Particles));
+}
+
+RbpfBallFilter::RbpfBallFilter():
+	RbpfBallFilter(configuredParticles())
+{
+}
+
+RbpfBallFilter::RbpfBallFilter(int numParticles):
+	_numParticles(max(1, min(numParticles, (int)Max_Particles)))
+{
+	reset();
+}
+
+void RbpfBallFilter::reset()
+{
+	_time = 0;
+	_pos = Point();
+	_vel = Point();
+	_velocityVar = Initial_Velocity_Var;
+	_kickedFraction = 0;
+
+	// Fixed, so runs on the same vision are repeatable
+	_random[0] = 1;
+	_random[1] = 2;
+	_random[2] = 3;
+}
+
+void RbpfBallFilter::update(const BallObservation *obs, const SystemState *state)
+{
+	// Where the ball would be now if it kept rolling, to see if a robot is there
+	Ball predicted;
+	predict(obs->time, &predicted, 0);
+
+	bool nearRobot = false;
+	if (_time)
+	{
+		for (const Robot *r : state->self)
+		{
+			nearRobot = nearRobot || (r->visible && r->pos.nearPoint(predicted.pos, Kick_Distance));
+		}
+		for (const Robot *r : state->opp)
+		{
+			nearRobot = nearRobot || (r->visible && r->pos.nearPoint(predicted.pos, Kick_Distance));
+		}
+	}
+
+	update(obs->pos, obs->time, nearRobot ? Near_Kick_Probability : Kick_Probability);
+}
+
+void RbpfBallFilter::update(const Point &pos, Time time, float kickProbability)
+{
+	const int n = _numParticles;
+	const float posR = Position_Noise * Position_Noise;
+
+	if (!_time)
+	{
+		// First observation: every particle starts here, not moving
+		_particles.x.head(n).setConstant(pos.x);
+		_particles.y.head(n).setConstant(pos.y);
+		_particles.vx.head(n).setZero();
+		_particles.vy.head(n).setZero();
+		_particles.posVar.head(n).setConstant(posR);
+		_particles.posVelCov.head(n).setZero();
+		_particles.velVar.head(n).setConstant(Initial_Velocity_Var);
+		_time = time;
+		updateEstimate();
+		return;
+	}
+
+	// Observations from several cameras may have the same time or be slightly out of order.
+	// They are applied without moving the particles forward.
+	const float dt = max(0.0f, (float)((int64_t)(time - _time) * TimestampToSecs));
+	_time = max(_time, time);
+
+	// Both halves of the candidates come from the same particles, so any difference
+	// in weight is from the model and how well it explains the observation.
+	// The ball can't have been kicked between observations at the same time.
+	if (dt > 0)
+	{
+		hypothesis(0, 0, logf(1 - kickProbability), dt, pos.x, pos.y);
+		hypothesis(n, Kick_Velocity_Var, logf(kickProbability), dt, pos.x, pos.y);
+		resample(n * 2);
+	} else {
+		hypothesis(0, 0, 0, dt, pos.x, pos.y);
+		resample(n);
+	}
+	updateEstimate();
+}
+
+void RbpfBallFilter::hypothesis(int offset, float velocityVar, float logTransition, float dt, float zx, float zy)
+{
+	const int n = _numParticles;
+	const float posR = Position_Noise * Position_Noise;
+	const float dt2 = dt * dt;
+	const float dt3 = dt2 * dt;
+
+	const auto x = _particles.x.head(n);
+	const auto y = _particles.y.head(n);
+	const auto vx = _particles.vx.head(n);
+	const auto vy = _particles.vy.head(n);
+
+	// Rolling friction slows the ball without turning it around.
+	// The new velocity is used for the mean, and the position moves by the average of the two.
+	ParticleArray scale;
+	const auto speed = (vx.square() + vy.square()).sqrt();
+	scale.head(n) = (speed > 1e-6f).select((1 - Rolling_Deceleration * dt / speed).max(0.0f), 0.0f);
+	const auto nvx = vx * scale.head(n);
+	const auto nvy = vy * scale.head(n);
+	ParticleArray px, py;
+	px.head(n) = x + (vx + nvx) * (dt / 2);
+	py.head(n) = y + (vy + nvy) * (dt / 2);
+
+	// Predicted covariance
+	const auto p11 = _particles.velVar.head(n) + velocityVar;
+	ParticleArray a00, a01, a11;
+	a00.head(n) = _particles.posVar.head(n) + 2 * dt * _particles.posVelCov.head(n) + dt2 * p11 + Rolling_Process_Noise * dt3 / 3;
+	a01.head(n) = _particles.posVelCov.head(n) + dt * p11 + Rolling_Process_Noise * dt2 / 2;
+	a11.head(n) = p11 + Rolling_Process_Noise * dt;
+
+	// Innovation and its variance, which is the same on both axes
+	ParticleArray s, ex, ey;
+	s.head(n) = a00.head(n) + posR;
+	ex.head(n) = zx - px.head(n);
+	ey.head(n) = zy - py.head(n);
+
+	const auto k0 = a00.head(n) / s.head(n);
+	const auto k1 = a01.head(n) / s.head(n);
+
+	_candidates.x.segment(offset, n) = px.head(n) + k0 * ex.head(n);
+	_candidates.y.segment(offset, n) = py.head(n) + k0 * ey.head(n);
+	_candidates.vx.segment(offset, n) = nvx + k1 * ex.head(n);
+	_candidates.vy.segment(offset, n) = nvy + k1 * ey.head(n);
+	_candidates.posVar.segment(offset, n) = (1 - k0) * a00.head(n);
+	_candidates.posVelCov.segment(offset, n) = (1 - k0) * a01.head(n);
+	_candidates.velVar.segment(offset, n) = a11.head(n) - k1 * a01.head(n);
+
+	// Log of the observation's probability under a 2D Gaussian with variance s on each axis,
+	// less the constant, plus the log of the chance of following this model
+	_logWeight.segment(offset, n) = logTransition - (ex.head(n).square() + ey.head(n).square()) / (2 * s.head(n)) - s.head(n).log();
+}
+
+void RbpfBallFilter::resample(int total)
+{
+	const int n = _numParticles;
+
+	// Weights relative to the most likely candidate, so an unlikely observation
+	// doesn't make all of them underflow
+	const float maxLog = _logWeight.head(total).maxCoeff();
+	float sum = 0;
+	for (int i = 0; i < total; ++i)
+	{
+		sum += expf(_logWeight[i] - maxLog);
+		_cumulativeWeight[i] = sum;
+	}
+
+	// Systematic resampling: one random offset, then evenly spaced picks
+	const float step = sum / n;
+	float u = erand48(_random) * step;
+	int kicked = 0;
+	for (int i = 0, j = 0; i < n; ++i, u += step)
+	{
+		while (j < total - 1 && _cumulativeWeight[j] < u)
+		{
+			++j;
+		}
+
+		_particles.x[i] = _candidates.x[j];
+		_particles.y[i] = _candidates.y[j];
+		_particles.vx[i] = _candidates.vx[j];
+		_particles.vy[i] = _candidates.vy[j];
+		_particles.posVar[i] = _candidates.posVar[j];
+		_particles.posVelCov[i] = _candidates.posVelCov[j];
+		_particles.velVar[i] = _candidates.velVar[j];
+		kicked += j >= n;
+	}
+
+	_kickedFraction = (float)kicked / n;
+}
+
+void RbpfBallFilter::updateEstimate()
+{
+	const int n = _numParticles;
+
+	// The particles have equal weights after resampling
+	_pos = Point(_particles.x.head(n).mean(), _particles.y.head(n).mean());
+	_vel = Point(_particles.vx.head(n).mean(), _particles.vy.head(n).mean());
+
+	// Variance of the mixture on one axis: each particle's own plus the spread between them
+	const float spread = ((_particles.vx.head(n) - _vel.x).square() + (_particles.vy.head(n) - _vel.y).square()).mean() / 2;
+	_velocityVar = _particles.velVar.head(n).mean() + spread;
+}
+
+void RbpfBallFilter::predict(Time time, Ball *out, float *velocityUncertainty)
+{
+	if (velocityUncertainty)
+	{
+		// Wide enough to find the ball again after a kick
+		*velocityUncertainty = max(2 + _vel.mag() * 0.5f, 3 * sqrtf(_velocityVar));
+	}
+
+	if (out)
+	{
+		// Rolling, until friction stops it
+		const float dt = max(0.0f, (float)((int64_t)(time - _time) * TimestampToSecs));
+		const float speed = _vel.mag();
+		const float t = (speed > 0) ? min(dt, speed / Rolling_Deceleration) : 0;
+		const Point vel = (speed > 0) ? _vel * ((speed - Rolling_Deceleration * t) / speed) : Point();
+
+		out->pos = _pos + (_vel + vel) * (t / 2);
+		out->vel = vel;
+		out->time = time;
+		out->valid = true;
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "BallFilter.hpp"
+#include <Configuration.hpp>
+
+#include <Eigen/Core>
+
+/**
+ * @brief Rao-Blackwellized particle filter for the ball
+ *
+ * @details
+ * This follows the filter in old/modeling-old/rbpf (after Kwok and Fox, "Map-Based
+ * Multiple Model Tracking of a Moving Object").  Each particle is a hypothesis about
+ * which motion model the ball has been following, with a Kalman filter over position
+ * and velocity given that history.  There are two models:
+ *   - rolling: constant velocity slowed by rolling friction, with little process noise
+ *   - kicked: the velocity may have changed to anything at the start of the interval
+ *
+ * Every observation expands each particle into one candidate per model, weights the
+ * candidates by how likely the observation is under each, and resamples back to the
+ * configured number of particles.  A kick is much more likely when the ball is next
+ * to a robot, which covers deflections as well as kicks.
+ *
+ * x and y get the same measurements and noise, so each particle's two axes share one
+ * covariance.  Particles are stored as one fixed-size array per value and every update
+ * is array arithmetic over all of them.  Nothing is allocated after construction.
+ */
+class RbpfBallFilter: public BallFilter
+{
+public:
+	/// Limit on the configured particle count
+	static const int Max_Particles = 256;
+
+	static void createConfiguration(Configuration *cfg);
+
+	/// True if the tracker should use this filter instead of BallFilter
+	static bool enabled()
+	{
+		return *_enabled;
+	}
+
+	/// Configured number of particles, within the limit
+	static int configuredParticles();
+
+	/// Uses the configured number of particles
+	RbpfBallFilter();
+
+	/// Uses @numParticles particles (at most Max_Particles)
+	explicit RbpfBallFilter(int numParticles);
+
+	virtual void reset();
+	virtual void update(const BallObservation *obs, const SystemState *state);
+	virtual void predict(Time time, Ball *out, float *velocityUncertainty);
+
+	/// Applies an observation.  @kickProbability is the chance that the ball was
+	/// kicked or deflected since the last one.
+	void update(const Geometry2d::Point &pos, Time time, float kickProbability);
+
+	int numParticles() const
+	{
+		return _numParticles;
+	}
+
+	/// Fraction of particles that think the ball was kicked at the last update
+	float kickedFraction() const
+	{
+		return _kickedFraction;
+	}
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+	typedef Eigen::Array<float, Max_Particles, 1> ParticleArray;
+	typedef Eigen::Array<float, Max_Particles * 2, 1> CandidateArray;
+
+	/// Each value of a set of particles, with the shared covariance of (x, vx) and (y, vy)
+	template<class A>
+	struct Particles
+	{
+		A x, y, vx, vy;
+		A posVar, posVelCov, velVar;
+	};
+
+	/// Fills candidates [offset, offset + _numParticles) with the particles updated under one
+	/// model, which adds @velocityVar to each velocity variance before predicting.
+	/// Their log likelihoods go in _logWeight.
+	void hypothesis(int offset, float velocityVar, float logTransition, float dt, float zx, float zy);
+
+	/// Picks _numParticles of the first @total candidates in proportion to their weights
+	void resample(int total);
+
+	/// Updates the mean state from the particles
+	void updateEstimate();
+
+	static ConfigBool *_enabled;
+	static ConfigInt *_particleCount;
+
+	int _numParticles;
+
+	/// Time of the last observation, or zero before the first one
+	Time _time;
+
+	Particles<ParticleArray> _particles;
+
+	/// Scratch for update(): each particle under each model
+	Particles<CandidateArray> _candidates;
+	CandidateArray _logWeight;
+	CandidateArray _cumulativeWeight;
+
+	/// Mean state at _time
+	Geometry2d::Point _pos, _vel;
+	float _velocityVar;
+	float _kickedFraction;
+
+	/// State for erand48
+	unsigned short _random[3];
+};
@@ -1,72 +1,226 @@
 #include "RobotFilter.hpp"
 #include <Utils.hpp>
-#include <iostream>
 
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
 using namespace Geometry2d;
 
 // How long to coast a robot's position when it isn't visible
 static const float Coast_Time = 0.8;
-static const float Velocity_Alpha = 0.2;
-static const float Min_Frame_Time = 0.014;
+
+// Standard deviation of vision measurements
+static const float Position_Noise = 0.01;	// m
+static const float Angle_Noise = 0.05;		// rad
+
+// Spectral density of the random acceleration in the constant-velocity model.
+// Larger values trust new measurements more and follow quick changes in speed.
+static const float Position_Process_Noise = 10;		// m^2/s^3
+static const float Angle_Process_Noise = 200;		// rad^2/s^3
+
+// Velocity variance when a robot is first seen, about how fast it could be going
+static const float Initial_Velocity_Var = 4;		// (m/s)^2
+static const float Initial_Angle_Velocity_Var = 100;	// (rad/s)^2
+
+// Wraps an angle into [-pi, pi] with arithmetic that can be vectorized
+static inline float wrapAngle(float a)
+{
+	float turns = a * (float)(0.5 / M_PI);
+	return a - (float)(2 * M_PI) * (int)(turns + copysignf(0.5f, turns));
+}
 
 RobotFilter::RobotFilter()
 {
-	_camera = -1;
+	_cameras.reserve(Max_Cameras);
 }
 
-void RobotFilter::update(const RobotObservation* obs)
+RobotFilter::Camera::Camera()
 {
-	if (obs->source < 0 || obs->source >= Num_Cameras)
+	anyPending = false;
+	for (int i = 0; i < Num_Robots; ++i)
+	{
+		x[i] = vx[i] = y[i] = vy[i] = angle[i] = angleVel[i] = 0;
+		posVar[i] = posVelCov[i] = velVar[i] = 0;
+		angleVar[i] = angleCov[i] = angleVelVar[i] = 0;
+		time[i] = 0;
+		pending[i] = 0;
+		zx[i] = zy[i] = zAngle[i] = 0;
+		zTime[i] = 0;
+	}
+}
+
+void RobotFilter::observe(int robot, const RobotObservation &obs)
+{
+	if (obs.source < 0 || obs.source >= Max_Cameras || robot < 0 || robot >= Num_Robots)
 	{
 		// Not from a camera?
 		return;
 	}
-	
-	int s = obs->source;
-	double dtime = (obs->time - _estimate[s].time) / 1000000.0f;
-	bool reset = _estimate[s].time == 0 || (dtime > Coast_Time);
-	
-	if (reset || dtime < Min_Frame_Time)
+
+	if ((int)_cameras.size() <= obs.source)
+	{
+		_cameras.resize(obs.source + 1);
+	}
+
+	Camera &cam = _cameras[obs.source];
+	cam.pending[robot] = 1;
+	cam.zx[robot] = obs.pos.x;
+	cam.zy[robot] = obs.pos.y;
+	cam.zAngle[robot] = obs.angle;
+	cam.zTime[robot] = obs.time;
+	cam.anyPending = true;
+}
+
+void RobotFilter::update()
+{
+	for (Camera &cam : _cameras)
 	{
-		_estimate[s].vel = Point();
-		_estimate[s].angleVel = 0;
-	} else {
-		Point newVel = (obs->pos - _estimate[s].pos) / dtime;
-		_estimate[s].vel = newVel * Velocity_Alpha + _estimate[s].vel * (1.0f - Velocity_Alpha);
-		
-		double newW = fixAngleRadians(obs->angle - _estimate[s].angle) / dtime;
-		_estimate[s].angleVel = newW * Velocity_Alpha + _estimate[s].angleVel * (1.0f - Velocity_Alpha);
+		if (cam.anyPending)
+		{
+			cam.update();
+		}
 	}
-	_estimate[s].pos = obs->pos;
-	_estimate[s].angle = obs->angle;
-	_estimate[s].visible = true;
-	_estimate[s].time = obs->time;
-	_estimate[s].visionFrame = obs->frameNumber;
 }
 
-void RobotFilter::predict(Time time, Robot* robot)
+void RobotFilter::Camera::update()
+{
+	const float posR = Position_Noise * Position_Noise;
+	const float angleR = Angle_Noise * Angle_Noise;
+
+	// Time since each robot's last observation.
+	// The 64-bit times are handled separately so the main loop is all floats.
+	float dts[Num_Robots];
+	float resets[Num_Robots];
+	for (int i = 0; i < Num_Robots; ++i)
+	{
+		const float dt = max(0.0f, (float)((int64_t)(zTime[i] - time[i]) * TimestampToSecs));
+		const bool reset = time[i] == 0 || dt > Coast_Time;
+		resets[i] = reset;
+		dts[i] = reset ? 0 : dt;
+		time[i] = pending[i] ? zTime[i] : time[i];
+	}
+
+	// Every robot goes through the same arithmetic.  Robots that weren't seen are
+	// left unchanged, and robots that haven't been seen recently start over.
+	for (int i = 0; i < Num_Robots; ++i)
+	{
+		const float seen = pending[i];
+		const float dt = dts[i];
+		const float reset = resets[i];
+
+		const float dt2 = dt * dt;
+		const float dt3 = dt2 * dt;
+
+		// Predict the covariance to the observation time.
+		// This is the same for x and y.
+		float p00 = posVar[i] + 2 * dt * posVelCov[i] + dt2 * velVar[i] + Position_Process_Noise * dt3 / 3;
+		float p01 = posVelCov[i] + dt * velVar[i] + Position_Process_Noise * dt2 / 2;
+		float p11 = velVar[i] + Position_Process_Noise * dt;
+
+		float a00 = angleVar[i] + 2 * dt * angleCov[i] + dt2 * angleVelVar[i] + Angle_Process_Noise * dt3 / 3;
+		float a01 = angleCov[i] + dt * angleVelVar[i] + Angle_Process_Noise * dt2 / 2;
+		float a11 = angleVelVar[i] + Angle_Process_Noise * dt;
+
+		// Gains
+		const float posS = p00 + posR;
+		const float k0 = p00 / posS;
+		const float k1 = p01 / posS;
+
+		const float angleS = a00 + angleR;
+		const float ka0 = a00 / angleS;
+		const float ka1 = a01 / angleS;
+
+		// Innovations against the predicted state
+		const float ex = zx[i] - (x[i] + vx[i] * dt);
+		const float ey = zy[i] - (y[i] + vy[i] * dt);
+		const float ea = wrapAngle(zAngle[i] - (angle[i] + angleVel[i] * dt));
+
+		float nx = x[i] + vx[i] * dt + k0 * ex;
+		float ny = y[i] + vy[i] * dt + k0 * ey;
+		float nvx = vx[i] + k1 * ex;
+		float nvy = vy[i] + k1 * ey;
+		float na = wrapAngle(angle[i] + angleVel[i] * dt + ka0 * ea);
+		float nw = angleVel[i] + ka1 * ea;
+
+		float n00 = (1 - k0) * p00;
+		float n01 = (1 - k0) * p01;
+		float n11 = p11 - k1 * p01;
+
+		float m00 = (1 - ka0) * a00;
+		float m01 = (1 - ka0) * a01;
+		float m11 = a11 - ka1 * a01;
+
+		// Robots that haven't been seen recently start over
+		nx += reset * (zx[i] - nx);
+		ny += reset * (zy[i] - ny);
+		nvx -= reset * nvx;
+		nvy -= reset * nvy;
+		na += reset * (zAngle[i] - na);
+		nw -= reset * nw;
+		n00 += reset * (posR - n00);
+		n01 -= reset * n01;
+		n11 += reset * (Initial_Velocity_Var - n11);
+		m00 += reset * (angleR - m00);
+		m01 -= reset * m01;
+		m11 += reset * (Initial_Angle_Velocity_Var - m11);
+
+		// Robots that weren't seen keep their state.
+		// The masks are applied with arithmetic rather than branches so this loop can be vectorized.
+		x[i] += seen * (nx - x[i]);
+		y[i] += seen * (ny - y[i]);
+		vx[i] += seen * (nvx - vx[i]);
+		vy[i] += seen * (nvy - vy[i]);
+		angle[i] += seen * (na - angle[i]);
+		angleVel[i] += seen * (nw - angleVel[i]);
+		posVar[i] += seen * (n00 - posVar[i]);
+		posVelCov[i] += seen * (n01 - posVelCov[i]);
+		velVar[i] += seen * (n11 - velVar[i]);
+		angleVar[i] += seen * (m00 - angleVar[i]);
+		angleCov[i] += seen * (m01 - angleCov[i]);
+		angleVelVar[i] += seen * (m11 - angleVelVar[i]);
+		pending[i] = 0;
+	}
+
+	anyPending = false;
+}
+
+int RobotFilter::latestSource(int robot) const
 {
 	int bestSource = -1;
-	double bestDTime = 0;
-	for (int s = 0; s < Num_Cameras; ++s)
+	for (unsigned int s = 0; s < _cameras.size(); ++s)
 	{
-		double dtime = (time - _estimate[s].time) / 1000000.0f;
-		if (_estimate[s].visible && (bestSource < 0 || dtime < bestDTime))
+		const Time t = _cameras[s].time[robot];
+		if (t && (bestSource < 0 || t > _cameras[bestSource].time[robot]))
 		{
 			bestSource = s;
-			bestDTime = dtime;
 		}
 	}
-	
+	return bestSource;
+}
+
+Time RobotFilter::lastObserved(int robot) const
+{
+	int source = latestSource(robot);
+	return (source < 0) ? 0 : _cameras[source].time[robot];
+}
+
+void RobotFilter::predict(Time time, int robot, RobotPose &pose) const
+{
+	const int bestSource = latestSource(robot);
+
 	if (bestSource < 0)
 	{
-		robot->visible = false;
+		pose.visible = false;
 		return;
 	}
-	
-	robot->pos = _estimate[bestSource].pos + _estimate[bestSource].vel * bestDTime;
-	robot->vel = _estimate[bestSource].vel;
-	robot->angle = fixAngleRadians(_estimate[bestSource].angle + _estimate[bestSource].angleVel * bestDTime);
-	robot->angleVel = _estimate[bestSource].angleVel;
-	robot->visible = _estimate[bestSource].visible && bestDTime < Coast_Time;
+
+	const Camera &cam = _cameras[bestSource];
+	const float dtime = (float)((int64_t)(time - cam.time[robot]) * TimestampToSecs);
+
+	pose.pos = Point(cam.x[robot], cam.y[robot]) + Point(cam.vx[robot], cam.vy[robot]) * dtime;
+	pose.vel = Point(cam.vx[robot], cam.vy[robot]);
+	pose.angle = fixAngleRadians(cam.angle[robot] + cam.angleVel[robot] * dtime);
+	pose.angleVel = cam.angleVel[robot];
+	pose.visible = dtime < Coast_Time;
 }
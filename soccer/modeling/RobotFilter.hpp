@@ -2,6 +2,8 @@
 
 #include <Robot.hpp>
 
+#include <vector>
+
 /**
  * @brief An observation of a robot's position and angle at a certain time
  *
@@ -22,7 +24,7 @@ public:
 	Time time;
 	int source;
 	int frameNumber;
-	
+
 	// Compares the times on two observations.  Used for sorting.
 	bool operator<(const RobotObservation &other) const
 	{
@@ -31,26 +33,87 @@ public:
 };
 
 /**
- * adjusts robot vision for accuracy and calculates velocities from positions
+ * @brief Kalman filters for every robot on the field, ours and theirs
+ *
+ * @details
+ * Each robot has a constant-velocity Kalman filter for each camera that has seen it.
+ * x, y, and angle are filtered separately.  Since x and y always get the same
+ * measurements and noise, they share one covariance.
+ *
+ * The state of all robots for one camera is stored as separate arrays of each value,
+ * so update() runs the same arithmetic over every robot at once, with the robots that
+ * weren't seen in the frame masked out.  Nothing is allocated after a camera is first seen.
+ *
+ * Robots are numbered by index(): our shells first, then theirs.
  */
 class RobotFilter
 {
 public:
+	static const int Num_Robots = Num_Shells * 2;
+
+	/// Camera IDs at or above this are ignored
+	static const int Max_Cameras = 8;
+
+	static int index(unsigned int shell, bool self)
+	{
+		return self ? shell : Num_Shells + shell;
+	}
+
 	RobotFilter();
-	
-	/// Gives a new observation to the filter
-	void update(const RobotObservation *obs);
-	
-	/// Generates a prediction of the ball's state at a given time in the future.
-	/// This may clear robot->visible if the prediction is too long in the future to be reliable.
-	void predict(Time time, Robot *robot);
+
+	/// Gives a new observation of @robot to the filter.
+	/// It isn't used until update() is called.
+	void observe(int robot, const RobotObservation &obs);
+
+	/// Applies the observations given since the last update().
+	/// Call this after each vision frame, so that a camera has at most one observation of each robot.
+	void update();
+
+	/// Generates a prediction of @robot's state at @time, from the camera that saw it most recently.
+	/// This clears pose.visible if the prediction is too long in the future to be reliable.
+	void predict(Time time, int robot, RobotPose &pose) const;
+
+	/// Time of the most recent observation of @robot that has been applied, or zero if it hasn't been seen
+	Time lastObserved(int robot) const;
+
+	/// Number of cameras that have been seen
+	int numCameras() const
+	{
+		return _cameras.size();
+	}
 
 private:
-	static const int Num_Cameras = 2;
-	
-	/// Estimate for each camera
-	RobotPose _estimate[Num_Cameras];
-	
-	/// Which camera we are using to track this robot, or -1 if it has not been seen recently
-	int _camera;
+	/// State of every robot as seen by one camera
+	struct Camera
+	{
+		Camera();
+
+		/// Filtered position and velocity on each axis
+		float x[Num_Robots], vx[Num_Robots];
+		float y[Num_Robots], vy[Num_Robots];
+		float angle[Num_Robots], angleVel[Num_Robots];
+
+		/// Covariance of (x, vx), which is the same as (y, vy): [pos pos, pos vel, vel vel]
+		float posVar[Num_Robots], posVelCov[Num_Robots], velVar[Num_Robots];
+
+		/// Covariance of (angle, angleVel)
+		float angleVar[Num_Robots], angleCov[Num_Robots], angleVelVar[Num_Robots];
+
+		/// Time of the last observation, or zero if never seen
+		Time time[Num_Robots];
+
+		/// Observations waiting for update().
+		/// pending is one for robots that have an observation and zero for the rest.
+		float pending[Num_Robots];
+		float zx[Num_Robots], zy[Num_Robots], zAngle[Num_Robots];
+		Time zTime[Num_Robots];
+		bool anyPending;
+
+		void update();
+	};
+
+	/// Index of the camera that saw @robot most recently, or -1
+	int latestSource(int robot) const;
+
+	std::vector<Camera> _cameras;
 };
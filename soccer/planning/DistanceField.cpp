@@ -0,0 +1,143 @@
+#include "DistanceField.hpp"
+
+#include <Geometry2d/Circle.hpp>
+#include <Geometry2d/CompositeShape.hpp>
+#include <Geometry2d/Polygon.hpp>
+#include <Constants.hpp>
+
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+using namespace Planning;
+using namespace Geometry2d;
+
+// Taken off of every cell so rounding in hit() and in the queries can't make a
+// point right on the edge of an obstacle look clear
+static const float Margin = 0.005f;
+
+// A segment query gives up (and says the segment may hit) after this many steps,
+// since segments that graze an obstacle take many short ones.
+static const int MaxSteps = 16;
+
+DistanceField::DistanceField():
+	_minX(0),
+	_minY(0),
+	_cellSize(1),
+	_width(0),
+	_height(0)
+{
+}
+
+float DistanceField::hitDistance(const Shape &shape, const Point &pt)
+{
+	if (const CompositeShape *composite = dynamic_cast<const CompositeShape *>(&shape))
+	{
+		float d = INFINITY;
+		for (const std::shared_ptr<Shape> &sub : *composite)
+		{
+			d = min(d, hitDistance(*sub, pt));
+			if (d <= 0)
+			{
+				break;
+			}
+		}
+		return d;
+	} else if (const Circle *circle = dynamic_cast<const Circle *>(&shape))
+	{
+		// Circle::hit() is within Robot_Radius of the circle
+		return max(0.0f, pt.distTo(circle->center) - circle->radius() - Robot_Radius);
+	} else if (const Rect *rect = dynamic_cast<const Rect *>(&shape))
+	{
+		// Rect::hit() is only the inside
+		float dx = max(max(rect->minx() - pt.x, pt.x - rect->maxx()), 0.0f);
+		float dy = max(max(rect->miny() - pt.y, pt.y - rect->maxy()), 0.0f);
+		return sqrtf(dx * dx + dy * dy);
+	} else if (const Polygon *polygon = dynamic_cast<const Polygon *>(&shape))
+	{
+		// Polygon::hit() is within Robot_Radius of the polygon
+		if (polygon->vertices.empty() || polygon->contains(pt))
+		{
+			return 0;
+		}
+
+		float d = INFINITY;
+		const vector<Point> &v = polygon->vertices;
+		for (unsigned int i = v.size() - 1, j = 0; j < v.size(); i = j++)
+		{
+			d = min(d, Segment(v[i], v[j]).distTo(pt));
+		}
+		return max(0.0f, d - Robot_Radius);
+	}
+
+	// Don't know anything about this shape
+	return 0;
+}
+
+void DistanceField::build(const Shape &shape, const Rect &area, float cellSize)
+{
+	_cellSize = cellSize;
+	_minX = area.minx();
+	_minY = area.miny();
+	_width = max(1, (int)ceilf((area.maxx() - _minX) / cellSize));
+	_height = max(1, (int)ceilf((area.maxy() - _minY) / cellSize));
+
+	// Distance to the hit region changes by at most the distance moved, so the value
+	// at a cell's center less half of its diagonal holds for the whole cell.
+	const float halfDiagonal = cellSize * (float)M_SQRT1_2;
+
+	_cells.resize(_width * _height);
+	for (int y = 0; y < _height; ++y)
+	{
+		for (int x = 0; x < _width; ++x)
+		{
+			Point center(_minX + (x + 0.5f) * cellSize, _minY + (y + 0.5f) * cellSize);
+			float d = hitDistance(shape, center) - halfDiagonal - Margin;
+			_cells[y * _width + x] = max(0.0f, d);
+		}
+	}
+}
+
+float DistanceField::clearance(const Point &pt) const
+{
+	int x = (int)floorf((pt.x - _minX) / _cellSize);
+	int y = (int)floorf((pt.y - _minY) / _cellSize);
+	if (x < 0 || y < 0 || x >= _width || y >= _height)
+	{
+		return 0;
+	}
+
+	return _cells[y * _width + x];
+}
+
+bool DistanceField::clear(const Segment &seg) const
+{
+	const Point delta = seg.pt[1] - seg.pt[0];
+	const float length = delta.mag();
+	if (length == 0)
+	{
+		return clear(seg.pt[0]);
+	}
+
+	const Point dir = delta / length;
+
+	// Nothing is hit within the clearance of a point, so the segment can be
+	// stepped along by that much each time.
+	float t = 0;
+	for (int i = 0; i < MaxSteps; ++i)
+	{
+		float c = clearance(seg.pt[0] + dir * t);
+		if (c <= 0)
+		{
+			return false;
+		}
+
+		t += c;
+		if (t >= length)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Geometry2d/Point.hpp>
+#include <Geometry2d/Rect.hpp>
+#include <Geometry2d/Segment.hpp>
+#include <Geometry2d/Shape.hpp>
+
+#include <vector>
+
+namespace Planning
+{
+	/**
+	 * @brief Precomputed clearance from a shape that doesn't move, for skipping collision tests
+	 *
+	 * @details
+	 * The field samples, over a grid, how far each cell is from the region where the
+	 * shape's hit() is true.  The stored values are lower bounds for everywhere in the cell,
+	 * so a query can only be told it is clear when it really is.  Anything near the shape,
+	 * or outside the grid, is reported as possibly hitting and has to be tested exactly.
+	 *
+	 * This is meant for the field obstacles in GameplayModule, which only change with the
+	 * field dimensions.  Most planning queries are far from them and are answered with a
+	 * few lookups.
+	 */
+	class DistanceField
+	{
+		public:
+			DistanceField();
+
+			/// Samples @shape over @area with square cells of @cellSize.
+			/// Circles, rects, polygons, and composites of them are supported.  Anything else
+			/// is treated as covering the whole area.
+			void build(const Geometry2d::Shape &shape, const Geometry2d::Rect &area, float cellSize);
+
+			bool empty() const
+			{
+				return _cells.empty();
+			}
+
+			/// A distance from @pt that the shape is known not to hit within, or zero if it may be hit
+			float clearance(const Geometry2d::Point &pt) const;
+
+			/// True if @pt definitely doesn't hit the shape
+			bool clear(const Geometry2d::Point &pt) const
+			{
+				return clearance(pt) > 0;
+			}
+
+			/// True if @seg definitely doesn't hit the shape.
+			/// This steps along the segment by the clearance at each step.
+			bool clear(const Geometry2d::Segment &seg) const;
+
+			/// Distance from @pt to where @shape's hit() is true, or zero inside it
+			static float hitDistance(const Geometry2d::Shape &shape, const Geometry2d::Point &pt);
+
+		private:
+			// Clearance for each cell, row by row
+			std::vector<float> _cells;
+			float _minX, _minY;
+			float _cellSize;
+			int _width, _height;
+	};
+}
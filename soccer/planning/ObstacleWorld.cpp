@@ -0,0 +1,297 @@
+#include "ObstacleWorld.hpp"
+
+#include <Geometry2d/Circle.hpp>
+#include <Geometry2d/Rect.hpp>
+#include <Geometry2d/Polygon.hpp>
+#include <Constants.hpp>
+
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+using namespace Planning;
+using namespace Geometry2d;
+
+// Primitives are tested in blocks of this many, so the tests can be written as
+// simple loops over the packed arrays (which the compiler can vectorize) with the
+// results kept on the stack.
+static const int BlockSize = 64;
+
+// Used instead of 1/0 in the slab test so that zero-length axes don't make NaNs
+static const float BigInverse = 1e30f;
+
+void ObstacleWorld::clear()
+{
+	_size = 0;
+	_circleX.clear();
+	_circleY.clear();
+	_circleRadiusSq.clear();
+	_circleOwner.clear();
+	_rectMinX.clear();
+	_rectMinY.clear();
+	_rectMaxX.clear();
+	_rectMaxY.clear();
+	_rectOwner.clear();
+	_otherMinX.clear();
+	_otherMinY.clear();
+	_otherMaxX.clear();
+	_otherMaxY.clear();
+	_other.clear();
+	_otherOwner.clear();
+	_fielded.clear();
+	_fields.clear();
+	_fieldedOwner.clear();
+}
+
+int ObstacleWorld::nextOwner()
+{
+	// Shapes past the end of a ShapeSet share its last bit, as in CompositeShape::hit()
+	const int last = ShapeSet().size() - 1;
+	return min(_size++, last);
+}
+
+void ObstacleWorld::add(const CompositeShape &obstacles)
+{
+	for (const std::shared_ptr<Shape> &shape : obstacles)
+	{
+		add(shape.get());
+	}
+}
+
+void ObstacleWorld::add(const Shape *shape)
+{
+	add(shape, nextOwner());
+}
+
+void ObstacleWorld::add(const Shape *shape, const DistanceField *field)
+{
+	if (!field || field->empty())
+	{
+		add(shape);
+		return;
+	}
+
+	_fielded.push_back(shape);
+	_fields.push_back(field);
+	_fieldedOwner.push_back(nextOwner());
+}
+
+void ObstacleWorld::addCircle(const Point &center, float radius)
+{
+	float r = radius + Robot_Radius;
+	_circleX.push_back(center.x);
+	_circleY.push_back(center.y);
+	_circleRadiusSq.push_back(r * r);
+	_circleOwner.push_back(nextOwner());
+}
+
+void ObstacleWorld::add(const Shape *shape, int owner)
+{
+	if (!shape)
+	{
+		return;
+	}
+
+	if (const CompositeShape *composite = dynamic_cast<const CompositeShape *>(shape))
+	{
+		// A nested composite is hit if any of its subshapes are
+		for (const std::shared_ptr<Shape> &sub : *composite)
+		{
+			add(sub.get(), owner);
+		}
+	} else if (const Circle *circle = dynamic_cast<const Circle *>(shape))
+	{
+		float r = circle->radius() + Robot_Radius;
+		_circleX.push_back(circle->center.x);
+		_circleY.push_back(circle->center.y);
+		_circleRadiusSq.push_back(r * r);
+		_circleOwner.push_back(owner);
+	} else if (const Rect *rect = dynamic_cast<const Rect *>(shape))
+	{
+		_rectMinX.push_back(rect->minx());
+		_rectMinY.push_back(rect->miny());
+		_rectMaxX.push_back(rect->maxx());
+		_rectMaxY.push_back(rect->maxy());
+		_rectOwner.push_back(owner);
+	} else {
+		float minX = -INFINITY, minY = -INFINITY;
+		float maxX = INFINITY, maxY = INFINITY;
+
+		const Polygon *polygon = dynamic_cast<const Polygon *>(shape);
+		if (polygon && !polygon->vertices.empty())
+		{
+			// Polygon::hit() includes everything within Robot_Radius of the polygon
+			minX = maxX = polygon->vertices[0].x;
+			minY = maxY = polygon->vertices[0].y;
+			for (const Point &v : polygon->vertices)
+			{
+				minX = min(minX, v.x);
+				minY = min(minY, v.y);
+				maxX = max(maxX, v.x);
+				maxY = max(maxY, v.y);
+			}
+			minX -= Robot_Radius;
+			minY -= Robot_Radius;
+			maxX += Robot_Radius;
+			maxY += Robot_Radius;
+		}
+
+		_otherMinX.push_back(minX);
+		_otherMinY.push_back(minY);
+		_otherMaxX.push_back(maxX);
+		_otherMaxY.push_back(maxY);
+		_other.push_back(shape);
+		_otherOwner.push_back(owner);
+	}
+}
+
+bool ObstacleWorld::query(const Segment &seg, bool isPoint, ShapeSet *hitSet, const ShapeSet *ignore) const
+{
+	const float x0 = seg.pt[0].x, y0 = seg.pt[0].y;
+	const float dx = seg.pt[1].x - x0, dy = seg.pt[1].y - y0;
+	const float lengthSq = dx * dx + dy * dy;
+	const float invLengthSq = (lengthSq > 0) ? (1 / lengthSq) : 0;
+
+	const float segMinX = min(x0, x0 + dx), segMaxX = max(x0, x0 + dx);
+	const float segMinY = min(y0, y0 + dy), segMaxY = max(y0, y0 + dy);
+
+	// Inverse direction for the slab test
+	const float invDx = (dx != 0) ? (1 / dx) : BigInverse;
+	const float invDy = (dy != 0) ? (1 / dy) : BigInverse;
+
+	// Obstacles past the end of a ShapeSet share its last bit, so in @ignore that bit
+	// only says that one of them contains the start.  Each of their primitives is
+	// checked for the start itself, which is only done when it is hit.  A nested
+	// composite there can then only be left through the subshapes the start is in.
+	const int overflow = ShapeSet().size() - 1;
+	auto ignored = [&](int owner) -> bool
+	{
+		return ignore && (*ignore)[owner] && owner != overflow;
+	};
+
+	// Records a hit on a primitive belonging to @owner.  @containsStart only needs to be
+	// right for the overflow owner.  Returns true if the query is finished.
+	auto found = [&](int owner, bool containsStart) -> bool
+	{
+		if (hitSet)
+		{
+			hitSet->set(owner);
+			return false;
+		}
+
+		return !ignore || !(*ignore)[owner] || (owner == overflow && !containsStart);
+	};
+
+	bool flags[BlockSize];
+
+	// Circles: squared distance from the center to the closest point on the segment
+	const int numCircles = _circleX.size();
+	for (int base = 0; base < numCircles; base += BlockSize)
+	{
+		const int n = min(BlockSize, numCircles - base);
+		const float *cx = &_circleX[base];
+		const float *cy = &_circleY[base];
+		const float *r2 = &_circleRadiusSq[base];
+		for (int i = 0; i < n; ++i)
+		{
+			float ex = cx[i] - x0;
+			float ey = cy[i] - y0;
+			float t = min(1.0f, max(0.0f, (ex * dx + ey * dy) * invLengthSq));
+			float qx = ex - t * dx;
+			float qy = ey - t * dy;
+			flags[i] = (qx * qx + qy * qy) <= r2[i];
+		}
+
+		for (int i = 0; i < n; ++i)
+		{
+			const int owner = _circleOwner[base + i];
+			if (flags[i] && found(owner, owner == overflow && (cx[i] - x0) * (cx[i] - x0) + (cy[i] - y0) * (cy[i] - y0) <= r2[i]))
+			{
+				return true;
+			}
+		}
+	}
+
+	// Rects: slab test of the segment against each box
+	const int numRects = _rectMinX.size();
+	for (int base = 0; base < numRects; base += BlockSize)
+	{
+		const int n = min(BlockSize, numRects - base);
+		const float *minX = &_rectMinX[base];
+		const float *minY = &_rectMinY[base];
+		const float *maxX = &_rectMaxX[base];
+		const float *maxY = &_rectMaxY[base];
+		for (int i = 0; i < n; ++i)
+		{
+			float tx0 = (minX[i] - x0) * invDx, tx1 = (maxX[i] - x0) * invDx;
+			float ty0 = (minY[i] - y0) * invDy, ty1 = (maxY[i] - y0) * invDy;
+			float tEnter = max(max(min(tx0, tx1), min(ty0, ty1)), 0.0f);
+			float tExit = min(min(max(tx0, tx1), max(ty0, ty1)), 1.0f);
+
+			// The slab test is unreliable on axes the segment doesn't move along,
+			// so also check the segment's extent on those directly.
+			bool inX = segMaxX >= minX[i] && segMinX <= maxX[i];
+			bool inY = segMaxY >= minY[i] && segMinY <= maxY[i];
+			flags[i] = inX && inY && tEnter <= tExit;
+		}
+
+		for (int i = 0; i < n; ++i)
+		{
+			const int owner = _rectOwner[base + i];
+			if (flags[i] && found(owner, owner == overflow && x0 >= minX[i] && x0 <= maxX[i] && y0 >= minY[i] && y0 <= maxY[i]))
+			{
+				return true;
+			}
+		}
+	}
+
+	// Everything else: bounding box first, then the shape's own test
+	const int numOther = _other.size();
+	for (int i = 0; i < numOther; ++i)
+	{
+		if (segMaxX < _otherMinX[i] || segMinX > _otherMaxX[i] || segMaxY < _otherMinY[i] || segMinY > _otherMaxY[i])
+		{
+			continue;
+		}
+
+		int owner = _otherOwner[i];
+		if (!hitSet && ignored(owner))
+		{
+			// Doesn't matter whether this one is hit
+			continue;
+		}
+
+		bool hit = isPoint ? _other[i]->hit(seg.pt[0]) : _other[i]->hit(seg);
+		if (hit && found(owner, owner == overflow && _other[i]->hit(seg.pt[0])))
+		{
+			return true;
+		}
+	}
+
+	// Fielded shapes: the field is checked once for each run of shapes that share it
+	const DistanceField *lastField = 0;
+	bool fieldClear = false;
+	const int numFielded = _fielded.size();
+	for (int i = 0; i < numFielded; ++i)
+	{
+		if (_fields[i] != lastField)
+		{
+			lastField = _fields[i];
+			fieldClear = isPoint ? lastField->clear(seg.pt[0]) : lastField->clear(seg);
+		}
+
+		int owner = _fieldedOwner[i];
+		if (fieldClear || (!hitSet && ignored(owner)))
+		{
+			continue;
+		}
+
+		bool hit = isPoint ? _fielded[i]->hit(seg.pt[0]) : _fielded[i]->hit(seg);
+		if (hit && found(owner, owner == overflow && _fielded[i]->hit(seg.pt[0])))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <Geometry2d/CompositeShape.hpp>
+#include <Geometry2d/Segment.hpp>
+#include "DistanceField.hpp"
+
+#include <vector>
+
+namespace Planning
+{
+	/**
+	 * @brief Flattened copy of a CompositeShape for fast collision queries
+	 *
+	 * @details
+	 * A planning query tests the same obstacles against hundreds of points and
+	 * segments.  Going through CompositeShape means a virtual call per shape per
+	 * test and recursing into nested composites.  An ObstacleWorld is built once per
+	 * query instead: nested composites are flattened, circles and rects are stored
+	 * in packed arrays that are tested in tight loops, and everything else
+	 * (polygons, mostly) is only tested exactly if its bounding box is close enough.
+	 *
+	 * Queries give the same answers as the CompositeShape they were built from,
+	 * including the ShapeSet indices, which refer to the composite's top-level subshapes.
+	 *
+	 * Shapes other than circles and rects are referenced, not copied, so the
+	 * CompositeShape must outlive the ObstacleWorld.
+	 */
+	class ObstacleWorld
+	{
+		public:
+			ObstacleWorld():
+				_size(0)
+			{
+			}
+
+			explicit ObstacleWorld(const Geometry2d::CompositeShape &obstacles):
+				_size(0)
+			{
+				build(obstacles);
+			}
+
+			/// Replaces the contents with @obstacles.  Storage is reused.
+			void build(const Geometry2d::CompositeShape &obstacles)
+			{
+				clear();
+				add(obstacles);
+			}
+
+			/// Removes all obstacles but keeps the storage
+			void clear();
+
+			/// Adds each of @obstacles' subshapes as a separate obstacle, like CompositeShape::add()
+			void add(const Geometry2d::CompositeShape &obstacles);
+
+			/// Adds one obstacle.  If it is a composite, all of its subshapes share one index.
+			void add(const Geometry2d::Shape *shape);
+
+			/// Adds one obstacle that lies inside the obstacles described by @field.
+			/// Queries that @field shows are clear skip testing @shape.
+			/// Several shapes can share a field, which must outlive this.
+			void add(const Geometry2d::Shape *shape, const DistanceField *field);
+
+			/// Adds an obstacle that behaves like a Geometry2d::Circle, without needing one to exist
+			void addCircle(const Geometry2d::Point &center, float radius);
+
+			/// Number of top-level shapes, which is the range of ShapeSet indices
+			int size() const
+			{
+				return _size;
+			}
+
+			bool hit(const Geometry2d::Point &pt) const
+			{
+				return query(Geometry2d::Segment(pt, pt), true, 0, 0);
+			}
+
+			bool hit(const Geometry2d::Segment &seg) const
+			{
+				return query(seg, false, 0, 0);
+			}
+
+			/// Adds the obstacles hit by @pt to @hitSet.  See CompositeShape::hit().
+			bool hit(const Geometry2d::Point &pt, Geometry2d::ShapeSet &hitSet) const
+			{
+				query(Geometry2d::Segment(pt, pt), true, &hitSet, 0);
+				return hitSet.any();
+			}
+
+			/// Adds the obstacles hit by @seg to @hitSet.  See CompositeShape::hit().
+			bool hit(const Geometry2d::Segment &seg, Geometry2d::ShapeSet &hitSet) const
+			{
+				query(seg, false, &hitSet, 0);
+				return hitSet.any();
+			}
+
+			/// Returns true if @seg hits any obstacle not in @startHit.  See CompositeShape::hitNew().
+			bool hitNew(const Geometry2d::Segment &seg, const Geometry2d::ShapeSet &startHit) const
+			{
+				return query(seg, false, 0, &startHit);
+			}
+
+		private:
+			void add(const Geometry2d::Shape *shape, int owner);
+
+			/// ShapeSet index for the next top-level obstacle
+			int nextOwner();
+
+			/// Tests @seg (which is a point if @isPoint) against everything.
+			/// If @hitSet is given, all hits are added to it.  Otherwise this returns at the first
+			/// hit on an obstacle that isn't in @ignore.
+			bool query(const Geometry2d::Segment &seg, bool isPoint, Geometry2d::ShapeSet *hitSet, const Geometry2d::ShapeSet *ignore) const;
+
+			int _size;
+
+			// Circles, with the radius already grown by Robot_Radius as in Circle::hit()
+			std::vector<float> _circleX, _circleY, _circleRadiusSq;
+			std::vector<int> _circleOwner;
+
+			// Rects
+			std::vector<float> _rectMinX, _rectMinY, _rectMaxX, _rectMaxY;
+			std::vector<int> _rectOwner;
+
+			// Other shapes, tested with their own hit() when their bounding box
+			// (grown by Robot_Radius) overlaps the query
+			std::vector<float> _otherMinX, _otherMinY, _otherMaxX, _otherMaxY;
+			std::vector<const Geometry2d::Shape *> _other;
+			std::vector<int> _otherOwner;
+
+			// Static shapes, only tested with their own hit() when their field doesn't show
+			// the query is clear.  Shapes that share a field are kept together.
+			std::vector<const Geometry2d::Shape *> _fielded;
+			std::vector<const DistanceField *> _fields;
+			std::vector<int> _fieldedOwner;
+	};
+}
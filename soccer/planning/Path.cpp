@@ -4,6 +4,7 @@
 #include "motion/TrapezoidalMotion.hpp"
 
 #include <stdexcept>
+#include <algorithm>
 
 using namespace std;
 using namespace Planning;
@@ -20,6 +21,32 @@ Planning::Path::Path(const Geometry2d::Point& p0, const Geometry2d::Point& p1) {
 	points.push_back(p1);
 }
 
+const std::vector<float> &Planning::Path::distances() const
+{
+    if (_distances.size() != points.size() ||
+        (!points.empty() && (_distancesFront != points.front() || _distancesBack != points.back())))
+    {
+        _distances.resize(points.size());
+        float length = 0;
+        for (unsigned int i = 0; i < points.size(); ++i)
+        {
+            if (i > 0)
+            {
+                length += (points[i] - points[i - 1]).mag();
+            }
+            _distances[i] = length;
+        }
+        
+        if (!points.empty())
+        {
+            _distancesFront = points.front();
+            _distancesBack = points.back();
+        }
+    }
+    
+    return _distances;
+}
+
 float Planning::Path::length(unsigned int start) const
 {
     if (points.empty() || start >= (points.size() - 1))
@@ -27,27 +54,19 @@ float Planning::Path::length(unsigned int start) const
         return 0;
     }
     
-    float length  = 0;
-    for (unsigned int i = start; i < (points.size() - 1); ++i)
-    {
-        length += (points[i + 1] - points[i]).mag();
-    }
-    return length;
+    const vector<float> &d = distances();
+    return d.back() - d[start];
 }
 
 float Planning::Path::length(unsigned int start, unsigned int end) const
 {
-    if (points.empty() || start >= (points.size() - 1))
+    if (points.empty() || start >= (points.size() - 1) || end <= start)
     {
         return 0;
     }
     
-    float length  = 0;
-    for (unsigned int i = start; i < end; ++i)
-    {
-        length += (points[i + 1] - points[i]).mag();
-    }
-    return length;
+    const vector<float> &d = distances();
+    return d[end] - d[start];
 }
 
 boost::optional<Geometry2d::Point> Planning::Path::start() const
@@ -90,7 +109,7 @@ int Planning::Path::nearestIndex(const Geometry2d::Point &pt) const
 	return index;
 }
 
-bool Planning::Path::hit(const Geometry2d::CompositeShape &obstacles, unsigned int start) const
+bool Planning::Path::hit(const ObstacleWorld &obstacles, unsigned int start) const
 {
     if (start >= points.size())
     {
@@ -99,17 +118,12 @@ bool Planning::Path::hit(const Geometry2d::CompositeShape &obstacles, unsigned i
     }
     
     // The set of obstacles the starting point was inside of
-    std::set<std::shared_ptr<Geometry2d::Shape> > hit;
+    Geometry2d::ShapeSet hit;
     obstacles.hit(points[start], hit);
     
     for (unsigned int i = start; i < (points.size() - 1); ++i)
     {
-        std::set<std::shared_ptr<Geometry2d::Shape> > newHit;
-        obstacles.hit(Geometry2d::Segment(points[i], points[i + 1]), newHit);
-        try
-        {
-            set_difference(newHit.begin(), newHit.end(), hit.begin(), hit.end(), ExceptionIterator<std::shared_ptr<Geometry2d::Shape>>());
-        } catch (exception& e)
+        if (obstacles.hitNew(Geometry2d::Segment(points[i], points[i + 1]), hit))
         {
             // Going into a new obstacle
             return true;
@@ -212,7 +226,7 @@ void Planning::Path::startFrom(const Geometry2d::Point& pt, Planning::Path& resu
 float Planning::Path::length(const Geometry2d::Point &pt) const
 {
 	float dist = -1;
-	float length = 0;
+	int best = -1;
 	if (points.empty())
 	{
 		return 0;
@@ -221,28 +235,26 @@ float Planning::Path::length(const Geometry2d::Point &pt) const
 	for (unsigned int i = 0; i < (points.size() - 1); ++i)
     {
 		Geometry2d::Segment s(points[i], points[i+1]);
-				
-		//add the segment length
-		length += s.length();
 		
 		const float d = s.distTo(pt);
 		
 		//if point closer to this segment
 		if (dist < 0 || d < dist)
 		{
-			//closest point on segment
-			Geometry2d::Point p = s.nearestPoint(pt);
-			
 			//new best distance
 			dist = d;
-			
-			//reset running length count
-			length = 0;
-			length += p.distTo(s.pt[1]);
+			best = i;
 		}
 	}
 	
-	return length;
+	if (best < 0)
+	{
+		return 0;
+	}
+	
+	//from the closest point on the segment to its end, then the rest of the path
+	Geometry2d::Segment s(points[best], points[best + 1]);
+	return s.nearestPoint(pt).distTo(s.pt[1]) + length(best + 1);
 }
 
 bool Planning::Path::getPoint(float distance ,Geometry2d::Point &position, Geometry2d::Point &direction) const
@@ -255,21 +267,18 @@ bool Planning::Path::getPoint(float distance ,Geometry2d::Point &position, Geome
 	{
 		return false;
 	}
-	for (unsigned int i = 0; i < (points.size() - 1); ++i)
-    {
-    	Geometry2d::Point vector(points[i + 1] - points[i]);
-		//Geometry2d::Segment s(points[i], points[i+1]);
-		
-		float vectorLength = vector.mag();
-		distance -= vectorLength;
-		
-		if(distance<=0) 
-		{
-			distance += vectorLength;
-			position = points[i] + (vector * (distance / vectorLength));
-			direction = vector.normalized();
-			return true;
-		}
+	
+	//the first point at least @distance along the path ends the segment we're on
+	const vector<float> &d = distances();
+	unsigned int end = lower_bound(d.begin() + 1, d.end(), distance) - d.begin();
+	if (end < points.size())
+	{
+		unsigned int i = end - 1;
+		Geometry2d::Point vector(points[i + 1] - points[i]);
+		float vectorLength = d[end] - d[i];
+		position = points[i] + (vector * ((distance - d[i]) / vectorLength));
+		direction = vector.normalized();
+		return true;
 	}
 	position = points.back();
 	return false;
@@ -313,27 +322,36 @@ bool Planning::Path::evaluate(float t, Geometry2d::Point &targetPosOut, Geometry
 		targetVelOut = Geometry2d::Point(0,0);
 		return false;
 	}
-	int i=0;
 	if (t<times[0])
 	{
 		targetPosOut = points[0];
 		targetVelOut = vels[0];
 		return false;
 	}
-	while (times[i]<=t)
+	
+	//	find the first time after t.
+	//	Times usually increase from one call to the next, so start from where the last call stopped.
+	const int n = times.size();
+	int i = _evaluateIndex;
+	if (i <= 0 || i >= n || times[i-1] > t)
 	{
-		if (times[i]==t) {
-			targetPosOut = points[i];
-			targetVelOut = vels[i];
-			return true;
-		}
-		i++;
-		if (i==size())
-		{
-			targetPosOut = points[i-1];
-			targetVelOut = Geometry2d::Point(0,0);
-			return false;
-		}
+		i = upper_bound(times.begin(), times.end(), t) - times.begin();
+	} else if (times[i] <= t)
+	{
+		i = upper_bound(times.begin() + i + 1, times.end(), t) - times.begin();
+	}
+	_evaluateIndex = i;
+	
+	if (times[i-1]==t) {
+		targetPosOut = points[i-1];
+		targetVelOut = vels[i-1];
+		return true;
+	}
+	if (i==n)
+	{
+		targetPosOut = points[i-1];
+		targetVelOut = Geometry2d::Point(0,0);
+		return false;
 	}
 	float deltaT = (times[i] - times[i-1]);
 	if (deltaT==0)
@@ -356,5 +374,6 @@ float Planning::Path::getTime(int index) const
         throw std::runtime_error("You must set maxSpeed and maxAcceleration before calling Path.evaluate()");
     }
 
-	return Trapezoidal::getTime(length(0,index), length(), maxSpeed, maxAcceleration, startSpeed, endSpeed);
+	const vector<float> &d = distances();
+	return Trapezoidal::getTime(d[index], d.back(), maxSpeed, maxAcceleration, startSpeed, endSpeed);
 }
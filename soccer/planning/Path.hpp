@@ -4,6 +4,7 @@
 #include <Geometry2d/Point.hpp>
 #include <Geometry2d/Segment.hpp>
 #include <Geometry2d/CompositeShape.hpp>
+#include <planning/ObstacleWorld.hpp>
 #include <Configuration.hpp>
 
 namespace Planning
@@ -14,6 +15,12 @@ namespace Planning
 	 * @details The path represents a function of position given time that the robot should follow.  A
 	 * line-segment-based path comes from the planner, then we use cubic bezier curves to interpolate
 	 * and smooth it out.  This is done via the evaulate() method.
+	 *
+	 * Lengths and positions along the path are looked up in a table of cumulative distances that
+	 * is built the first time it's needed, so they don't walk the whole path.  evaluate() also
+	 * remembers where it stopped, so evaluating increasing times (as motion control does every
+	 * frame) is usually constant time.  These caches make a Path unsafe to query from two threads
+	 * at once.
 	 */
 	class Path
 	{
@@ -36,8 +43,25 @@ namespace Planning
 			void clear()
 			{
 				points.clear();
+				invalidate();
+			}
+			
+			/**
+			 * Discards the cached distances and evaluate() position.
+			 * This must be called after changing points, vels, or times.  The cache notices
+			 * when points are added or removed or the ends move, but not when other points move.
+			 */
+			void invalidate()
+			{
+				_distances.clear();
+				_evaluateIndex = 0;
 			}
 			
+			/**
+			 * Distance along the path from the first point to each point
+			 */
+			const std::vector<float> &distances() const;
+			
 			/**
 			 * Calulates the length of the path 
 			 *
@@ -84,9 +108,10 @@ namespace Planning
 
 			// Returns true if the path never touches an obstacle or additionally, when exitObstacles is true, if the path
 			// starts out in an obstacle but leaves and never re-enters any obstacle.
-			bool hit(const Geometry2d::CompositeShape &shape, unsigned int start = 0) const;
+			bool hit(const ObstacleWorld &obstacles, unsigned int start = 0) const;
 			
-			// Set of points in the path - used as waypoints
+			// Set of points in the path - used as waypoints.
+			// Call invalidate() after changing these.
 			std::vector<Geometry2d::Point> points;
 			std::vector<Geometry2d::Point> vels;
 			std::vector<float> times;
@@ -133,5 +158,14 @@ namespace Planning
 			///	note: you MUST set these before calling evaluate or else it'll throw an exception
 			float maxSpeed = -1;
 			float maxAcceleration = -1;
+
+		private:
+			///	cumulative distances returned by distances(), and the end points they were built for
+			mutable std::vector<float> _distances;
+			mutable Geometry2d::Point _distancesFront;
+			mutable Geometry2d::Point _distancesBack;
+
+			///	index in times where the last evaluate() stopped
+			mutable int _evaluateIndex = 0;
 	};
 }
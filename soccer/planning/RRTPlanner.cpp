@@ -3,7 +3,7 @@
 #include <stdlib.h>
 #include <iostream>
 #include <algorithm>
-#include <Eigen/Dense>
+#include <math.h>
 #include "RRTPlanner.hpp"
 
 #include <Constants.hpp>
@@ -13,12 +13,30 @@
 using namespace std;
 using namespace Planning;
 
+namespace Planning
+{
+	REGISTER_CONFIGURABLE(RRTPlanner)
+}
+
+ConfigBool *RRTPlanner::_errt;
+ConfigDouble *RRTPlanner::_goalBias;
+ConfigDouble *RRTPlanner::_waypointBias;
+ConfigInt *RRTPlanner::_waypointCacheSize;
+ConfigInt *RRTPlanner::_refineAttempts;
 
+void RRTPlanner::createConfiguration(Configuration *cfg)
+{
+	_errt = new ConfigBool(cfg, "RRT/ERRT", true);
+	_goalBias = new ConfigDouble(cfg, "RRT/Goal Bias", 0.1);
+	_waypointBias = new ConfigDouble(cfg, "RRT/Waypoint Bias", 0.4);
+	_waypointCacheSize = new ConfigInt(cfg, "RRT/Waypoint Cache Size", 100);
+	_refineAttempts = new ConfigInt(cfg, "RRT/Refine Attempts", 50);
+}
 
-Geometry2d::Point Planning::randomPoint()
+Geometry2d::Point Planning::randomPoint(unsigned short state[3])
 {
-	float x = Field_Dimensions::Current_Dimensions.FloorWidth() * (drand48() - 0.5f);
-	float y = Field_Dimensions::Current_Dimensions.FloorLength() * drand48() - Field_Dimensions::Current_Dimensions.Border();
+	float x = Field_Dimensions::Current_Dimensions.FloorWidth() * (erand48(state) - 0.5f);
+	float y = Field_Dimensions::Current_Dimensions.FloorLength() * erand48(state) - Field_Dimensions::Current_Dimensions.Border();
 
 	return Geometry2d::Point(x, y);
 }
@@ -26,6 +44,14 @@ Geometry2d::Point Planning::randomPoint()
 RRTPlanner::RRTPlanner()
 {
 	_maxIterations = 100;
+	_iterations = 0;
+	_deadline = 0;
+	
+	// Seed from the shared generator so runs are still repeatable with srand48()
+	for (int i = 0; i < 3; ++i)
+	{
+		_randomState[i] = lrand48();
+	}
 }
 
 void RRTPlanner::run(
@@ -33,12 +59,13 @@ void RRTPlanner::run(
 		const float angle, 
 		const Geometry2d::Point &vel,
 		const MotionConstraints &motionConstraints,
-		const Geometry2d::CompositeShape *obstacles,
+		const ObstacleWorld *obstacles,
 		Planning::Path &path)
 {
 	Geometry2d::Point goal = *motionConstraints.targetPos;
 	_motionConstraints = motionConstraints;
 	vi = vel;
+	_goal = goal;
 
 	//clear any old path
 	path.clear();
@@ -50,6 +77,8 @@ void RRTPlanner::run(
 	{
 		path.points.push_back(start);
 		_bestPath = path;
+		_waypoints.clear();
+		_iterations = 0;
 		return;
 	}
 
@@ -64,16 +93,16 @@ void RRTPlanner::run(
 
 		// The starting point is in an obstacle
 		// extend the tree until we find an unobstructed point
-		for (int i= 0 ; i< 100 ; ++i)
+		for (int i= 0 ; i< 100 && !pastDeadline(); ++i)
 		{
-			Geometry2d::Point r = randomPoint();
+			Geometry2d::Point r = randomPoint(_randomState);
 
 			//extend to a random point
 			Tree::Point* newPoint = goalTree.extend(r);
 
 			//if the new point is not blocked
 			//it becomes the new goal
-			if (newPoint && newPoint->hit.empty())
+			if (newPoint && newPoint->hit.none())
 			{
 				newGoal = newPoint->pos;
 				break;
@@ -104,17 +133,145 @@ void RRTPlanner::run(
 		return;
 	}
 	*/
-	_fixedStepTree0.init(start, obstacles);
-	_fixedStepTree1.init(_bestGoal, obstacles);
+	//see if we found a better global path
+	Planning::Path newPath;
+	if (connectTrees(start, _bestGoal, newPath))
+	{
+		newPath.vi = vi;
+		optimize(newPath, _obstacles);
+		_bestPath = newPath;
+		cacheWaypoints(_waypoints);
+	}
+
+	if (_bestPath.points.empty())
+	{
+		// FIXME: without these two lines, an empty path is returned which causes errors down the line.
+		path.points.push_back(start);
+		_bestPath = path;
+		return;
+	}
+	
+	path = _bestPath;
+}
+
+bool RRTPlanner::repair(
+		const Geometry2d::Point &start,
+		const Geometry2d::Point &vel,
+		const MotionConstraints &motionConstraints,
+		const ObstacleWorld *obstacles,
+		Planning::Path &path)
+{
+	path.clear();
+
+	const int n = _waypoints.size();
+	if (n < 2 || !obstacles || *motionConstraints.targetPos != _goal)
+	{
+		return false;
+	}
+
+	// Find where the robot is along the old path
+	int next = 1;
+	float nextDist = INFINITY;
+	for (int i = 1; i < n; ++i)
+	{
+		float d = Geometry2d::Segment(_waypoints[i - 1], _waypoints[i]).distTo(start);
+		if (d < nextDist)
+		{
+			nextDist = d;
+			next = i;
+		}
+	}
+
+	// Find the first blocked segment ahead of the robot
+	Geometry2d::ShapeSet startHit;
+	obstacles->hit(start, startHit);
+	Geometry2d::Point from = start;
+	int blocked = next;
+	for (; blocked < n; ++blocked)
+	{
+		if (obstacles->hitNew(Geometry2d::Segment(from, _waypoints[blocked]), startHit))
+		{
+			break;
+		}
+		from = _waypoints[blocked];
+	}
+	if (blocked >= n)
+	{
+		// Nothing in the way
+		return false;
+	}
+
+	// Reconnect to the first clear waypoint past the blockage.
+	// Everything after it must still be clear or this isn't a local problem.
+	int rejoin = blocked;
+	while (rejoin < n && obstacles->hit(_waypoints[rejoin]))
+	{
+		++rejoin;
+	}
+	if (rejoin >= n)
+	{
+		return false;
+	}
+	for (int i = rejoin; i < n - 1; ++i)
+	{
+		if (obstacles->hit(Geometry2d::Segment(_waypoints[i], _waypoints[i + 1])))
+		{
+			return false;
+		}
+	}
+
+	_motionConstraints = motionConstraints;
+	vi = vel;
+	_obstacles = obstacles;
+
+	Planning::Path newPath;
+	if (!connectTrees(start, _waypoints[rejoin], newPath))
+	{
+		return false;
+	}
+
+	// connectTrees() ends at the rejoin waypoint
+	newPath.points.insert(newPath.points.end(), _waypoints.begin() + rejoin + 1, _waypoints.end());
+	newPath.invalidate();
+	newPath.vi = vi;
+	optimize(newPath, _obstacles);
+	_bestPath = newPath;
+	cacheWaypoints(_waypoints);
+
+	path = _bestPath;
+	return true;
+}
+
+bool RRTPlanner::connectTrees(const Geometry2d::Point &start, const Geometry2d::Point &goal, Planning::Path &path)
+{
+	_fixedStepTree0.init(start, _obstacles);
+	_fixedStepTree1.init(goal, _obstacles);
 	_fixedStepTree0.step = _fixedStepTree1.step = .15f;
+	_iterations = 0;
+
+	// The last path is only reused if it's still going to the same place.
+	// If smoothing it ran into something, reusing it would give the same result,
+	// so start over instead.
+	Tree::Point* seeded = 0;
+	if (*_errt && !_bestPath.hit(*_obstacles, max(0, _bestPath.nearestIndex(start))))
+	{
+		seeded = seedFromLastPath(goal);
+	}
+
+	if (seeded && _fixedStepTree1.connect(seeded->pos))
+	{
+		// The rest of the last path is still good
+		return makePath(path);
+	}
 
 	/// run global position best path search
 	Tree* ta = &_fixedStepTree0;
 	Tree* tb = &_fixedStepTree1;
 
-	for (unsigned int i=0 ; i<_maxIterations; ++i)
+	for (unsigned int i=0 ; i<_maxIterations && !pastDeadline(); ++i)
 	{
-		Geometry2d::Point r = randomPoint();
+		++_iterations;
+		Geometry2d::Point r = sample(tb->start()->pos);
 
 		Tree::Point* newPoint = ta->extend(r);
 
@@ -134,21 +291,152 @@ void RRTPlanner::run(
 		swap(ta, tb);
 	}
 
-	//see if we found a better global path
-	makePath();
+	return makePath(path);
+}
 
-	if (_bestPath.points.empty())
+bool RRTPlanner::pastDeadline() const
+{
+	return _deadline && monotonicTimestamp() >= _deadline;
+}
+
+void RRTPlanner::refine(vector<Geometry2d::Point> &points, const ObstacleWorld *obstacles)
+{
+	if (!_deadline)
 	{
-		// FIXME: without these two lines, an empty path is returned which causes errors down the line.
-		path.points.push_back(start);
-		_bestPath = path;
 		return;
 	}
-	
-	path = _bestPath;
+
+	vector<float> distances;
+	int failures = 0;
+	while (failures < *_refineAttempts && points.size() > 2 && !pastDeadline())
+	{
+		++failures;
+		
+		distances.resize(points.size());
+		distances[0] = 0;
+		for (unsigned int i = 1; i < points.size(); ++i)
+		{
+			distances[i] = distances[i - 1] + points[i].distTo(points[i - 1]);
+		}
+
+		// Two random places along the path, on different segments
+		float a = erand48(_randomState) * distances.back();
+		float b = erand48(_randomState) * distances.back();
+		if (a > b)
+		{
+			swap(a, b);
+		}
+		int ia = upper_bound(distances.begin(), distances.end(), a) - distances.begin() - 1;
+		int ib = upper_bound(distances.begin(), distances.end(), b) - distances.begin() - 1;
+		ia = min(ia, (int)points.size() - 2);
+		ib = min(ib, (int)points.size() - 2);
+		if (ia == ib)
+		{
+			continue;
+		}
+
+		Geometry2d::Point pa = points[ia] + (points[ia + 1] - points[ia]) * ((a - distances[ia]) / (distances[ia + 1] - distances[ia]));
+		Geometry2d::Point pb = points[ib] + (points[ib + 1] - points[ib]) * ((b - distances[ib]) / (distances[ib + 1] - distances[ib]));
+		if (obstacles->hit(Geometry2d::Segment(pa, pb)))
+		{
+			continue;
+		}
+
+		// Replace everything between them with the shortcut.
+		// This is always shorter, by the triangle inequality.
+		// Points that land on an existing one aren't added again so segments never have zero length.
+		points.erase(points.begin() + ia + 1, points.begin() + ib + 1);
+		if (pb != points[ia + 1])
+		{
+			points.insert(points.begin() + ia + 1, pb);
+		}
+		if (pa != points[ia])
+		{
+			points.insert(points.begin() + ia + 1, pa);
+		}
+		failures = 0;
+	}
+}
+
+Geometry2d::Point RRTPlanner::sample(const Geometry2d::Point &target)
+{
+	if (!*_errt)
+	{
+		return randomPoint(_randomState);
+	}
+
+	double r = erand48(_randomState);
+	if (r < *_goalBias)
+	{
+		return target;
+	}
+
+	if (r < *_goalBias + *_waypointBias && !_waypointCache.empty())
+	{
+		return _waypointCache[nrand48(_randomState) % _waypointCache.size()];
+	}
+
+	return randomPoint(_randomState);
+}
+
+void RRTPlanner::cacheWaypoints(const vector<Geometry2d::Point> &points)
+{
+	const size_t cacheSize = max(0, (int)*_waypointCacheSize);
+	if (_waypointCache.size() > cacheSize)
+	{
+		_waypointCache.resize(cacheSize);
+	}
+
+	for (const Geometry2d::Point &pt : points)
+	{
+		if (_waypointCache.size() < cacheSize)
+		{
+			_waypointCache.push_back(pt);
+		} else if (cacheSize > 0)
+		{
+			_waypointCache[nrand48(_randomState) % cacheSize] = pt;
+		}
+	}
 }
 
-void RRTPlanner::makePath()
+Tree::Point* RRTPlanner::seedFromLastPath(const Geometry2d::Point &goal)
+{
+	Tree::Point* last = _fixedStepTree0.start();
+	const Geometry2d::Point start = last->pos;
+
+	const int n = _waypoints.size();
+	if (n < 2 || _waypoints.back() != goal)
+	{
+		return 0;
+	}
+
+	// Skip the part of the path that's behind us
+	int next = 1;
+	float nextDist = INFINITY;
+	for (int i = 1; i < n; ++i)
+	{
+		float d = Geometry2d::Segment(_waypoints[i - 1], _waypoints[i]).distTo(start);
+		if (d < nextDist)
+		{
+			nextDist = d;
+			next = i;
+		}
+	}
+
+	for (int i = next; i < n; ++i)
+	{
+		Tree::Point* p = _fixedStepTree0.addIfClear(_waypoints[i], last);
+		if (!p)
+		{
+			break;
+		}
+		last = p;
+	}
+
+	return (last->index() > 0) ? last : 0;
+}
+
+bool RRTPlanner::makePath(Planning::Path &newPath)
 {
 	Tree::Point* p0 = _fixedStepTree0.last();
 	Tree::Point* p1 = _fixedStepTree1.last();
@@ -156,11 +444,9 @@ void RRTPlanner::makePath()
 	//sanity check
 	if (!p0 || !p1 || p0->pos != p1->pos)
 	{
-		return;
+		return false;
 	}
 
-	Planning::Path newPath;
-
 	//add the start tree first...normal order
 	//aka from root to p0
 	_fixedStepTree0.addPath(newPath, p0);
@@ -168,40 +454,10 @@ void RRTPlanner::makePath()
 	//add the goal tree in reverse
 	//aka p1 to root
 	_fixedStepTree1.addPath(newPath, p1, true);
-	newPath.vi = vi;
-	optimize(newPath, _obstacles);
-
-	/// check the path against the old one
-	bool hit = (_obstacles) ? _bestPath.hit(*_obstacles) : false;
-
-	//TODO evaluate the old path based on the closest segment
-	//and the distance to the endpoint of that segment
-	//Otherwise, a new path will always be shorter than the old given we traveled some
-
-	/// Conditions to use new path
-	/// 1. old path is empty
-	/// 2. goal changed
-	/// 3. start changed -- maybe (Roman)
-	/// 3. new path is better
-	/// 4. old path not valid (hits obstacles)
-	//if (_bestPath.points.empty() ||
-	//		(hit) ||
-	//		//(_bestPath.points.front() != _fixedStepTree0.start()->pos) ||
-	//		(_bestPath.points.back() != _fixedStepTree1.start()->pos) ||
-	//		(newPath.length() < _bestPath.length()))
-	//{
-		_bestPath = newPath;
-	//	return;
-	//}
-	/*
-	else 
-	{
-		_bestPath.vi = vi;
-		cubicBezier(_bestPath, _obstacles);	
-	}*/
+	return true;
 }
 
-void RRTPlanner::optimize(Planning::Path &path, const Geometry2d::CompositeShape *obstacles)
+void RRTPlanner::optimize(Planning::Path &path, const ObstacleWorld *obstacles)
 {
 	unsigned int start = 0;
 
@@ -219,7 +475,7 @@ void RRTPlanner::optimize(Planning::Path &path, const Geometry2d::CompositeShape
 	pts.insert(pts.end(), begin, begin + start);
 
 	// The set of obstacles the starting point was inside of
-	std::set<shared_ptr<Geometry2d::Shape> > hit;
+	Geometry2d::ShapeSet hit;
 
 	again:
 	obstacles->hit(path.points[start], hit);
@@ -227,12 +483,7 @@ void RRTPlanner::optimize(Planning::Path &path, const Geometry2d::CompositeShape
 	// [start, start + 1] is guaranteed not to have a collision because it's already in the path.
 	for (unsigned int end = start + 2; end < path.points.size(); ++end)
 	{
-		std::set<shared_ptr<Geometry2d::Shape> > newHit;
-		obstacles->hit(Geometry2d::Segment(path.points[start], path.points[end]), newHit);
-		try
-		{
-			set_difference(newHit.begin(), newHit.end(), hit.begin(), hit.end(), ExceptionIterator<std::shared_ptr<Geometry2d::Shape>>());
-		} catch (exception& e)
+		if (obstacles->hitNew(Geometry2d::Segment(path.points[start], path.points[end]), hit))
 		{
 			start = end - 1;
 			goto again;
@@ -240,7 +491,12 @@ void RRTPlanner::optimize(Planning::Path &path, const Geometry2d::CompositeShape
 	}
 	// Done with the path
 	pts.push_back(path.points.back());
+	
+	// Spend any time left making it shorter
+	refine(pts, obstacles);
 	path.points = pts;
+	path.invalidate();
+	_waypoints = pts;
 	//quarticBezier(path, obstacles);
 	path.maxSpeed = _motionConstraints.maxSpeed;
 	path.endSpeed = _motionConstraints.endSpeed;
@@ -253,9 +509,8 @@ Geometry2d::Point pow(Geometry2d::Point &p1, float i)
 	return Geometry2d::Point(pow(p1.x, i), pow(p1.y, i));
 }
 
-using namespace Eigen;
 //TODO: Use targeted end velocity
-void RRTPlanner::cubicBezier (Planning::Path &path, const Geometry2d::CompositeShape *obstacles)
+void RRTPlanner::cubicBezier (Planning::Path &path, const ObstacleWorld *obstacles)
 {
 	int length = path.size();
 	int curvesNum = length-1;
@@ -269,24 +524,17 @@ void RRTPlanner::cubicBezier (Planning::Path &path, const Geometry2d::CompositeS
 	
 	Geometry2d::Point vi = path.vi;
 
-	vector<double> pointsX(length);
-	vector<double> pointsY(length);
 	vector<double> ks(length-1);
 	vector<double> ks2(length-1);
 	
 	
 	
-	for (int i=0; i<length; i++) {
-		pointsX[i] = path.points[i].x;
-		pointsY[i] = path.points[i].y;
-	}
 	for (int i=0; i<curvesNum; i++) {
 		ks[i] = 1.0/(path.getTime(i+1)-path.getTime(i));
 		ks2[i] = ks[i]*ks[i];
 	}
 	
-	VectorXd solutionX = cubicBezierCalc(vi.x, vf.x, pointsX, ks, ks2);
-	VectorXd solutionY = cubicBezierCalc(vi.y, vf.y, pointsY, ks, ks2);
+	cubicBezierCalc(vi, vf, path.points, ks, ks2, _controls);
 	
 	Geometry2d::Point p0, p1, p2, p3;
 	vector<Geometry2d::Point> pts;
@@ -299,8 +547,8 @@ void RRTPlanner::cubicBezier (Planning::Path &path, const Geometry2d::CompositeS
     {
     	p0 = path.points[i];
     	p3 = path.points[i+1];
-    	p1 = Geometry2d::Point(solutionX(i*2),solutionY(i*2));
-    	p2 = Geometry2d::Point(solutionX(i*2 + 1),solutionY(i*2 + 1));
+    	p1 = _controls[i*2];
+    	p2 = _controls[i*2 + 1];
     	
     	for (int j=0; j<interpolations; j++)
     	{
@@ -325,54 +573,117 @@ void RRTPlanner::cubicBezier (Planning::Path &path, const Geometry2d::CompositeS
     path.points = pts;
     path.vels = vels;
     path.times = times;
+    path.invalidate();
 }
 
-VectorXd RRTPlanner::cubicBezierCalc (double vi, double vf, vector<double> &points, 
-									vector<double> &ks, vector<double> &ks2)
-{
-	int curvesNum = points.size() - 1;
+// The system in cubicBezierCalc() is stored by rows, with each row holding the
+// columns from one left of the diagonal to three right of it.  Only two right of
+// the diagonal are used by the equations; the third is filled in by row swaps.
+static const int BandLower = 1;
+static const int BandWidth = 5;
 
+static inline double &bandAt(vector<double> &band, int row, int col)
+{
+	return band[row * BandWidth + col - row + BandLower];
+}
 
-	if (curvesNum == 1) 
+void RRTPlanner::cubicBezierCalc(Geometry2d::Point vi, Geometry2d::Point vf,
+		const vector<Geometry2d::Point> &points,
+		const vector<double> &ks, const vector<double> &ks2,
+		vector<Geometry2d::Point> &controls)
+{
+	int curvesNum = points.size() - 1;
+	
+	// Unknowns are the two inner control points of each curve: column 2n is the
+	// first one of curve n and 2n + 1 is the second.
+	//
+	// The rows are ordered so the system is banded:
+	//   row 0:       first control point gives the start velocity
+	//   row 2n + 1:  acceleration is continuous where curves n and n + 1 meet
+	//   row 2n + 2:  velocity is continuous there
+	//   last row:    last control point gives the end velocity
+	const int size = curvesNum * 2;
+	
+	// band holds the nonzero diagonals and rhs the x and y right-hand sides.
+	// These are kept between calls so planning doesn't allocate every time, and
+	// are per thread because robots are planned in parallel.
+	static thread_local vector<double> band;
+	static thread_local vector<double> rhs;
+	band.assign(size * BandWidth, 0);
+	rhs.assign(size * 2, 0);
+	
+	bandAt(band, 0, 0) = 1;
+	rhs[0] = vi.x / (3.0 * ks[0]) + points[0].x;
+	rhs[1] = vi.y / (3.0 * ks[0]) + points[0].y;
+	
+	for (int n = 0; n < curvesNum - 1; n++)
 	{
+		const Geometry2d::Point &p = points[n + 1];
 		
-		VectorXd vector(2);
-		vector[0] = vi/(3.0*ks[0]) + points[0];
-		vector[1] = points[curvesNum] - vf/(3*ks[curvesNum-1]);
-		return vector;
-	}
-	else {
-		int matrixSize = curvesNum*2;
-		MatrixXd equations = MatrixXd::Zero(matrixSize, matrixSize);
-		VectorXd answer(matrixSize);
-		equations(0,0) = 1;
-		answer(0) = vi/(3.0*ks[0]) + points[0];
-		equations(1,matrixSize-1) = 1;
-		answer(1) = points[curvesNum] - vf/(3*ks[curvesNum-1]);
+		int row = n * 2 + 1;
+		bandAt(band, row, n * 2) = ks2[n];
+		bandAt(band, row, n * 2 + 1) = -2 * ks2[n];
+		bandAt(band, row, n * 2 + 2) = 2 * ks2[n + 1];
+		bandAt(band, row, n * 2 + 3) = -ks2[n + 1];
+		rhs[row * 2] = p.x * (ks2[n + 1] - ks2[n]);
+		rhs[row * 2 + 1] = p.y * (ks2[n + 1] - ks2[n]);
+		
+		row++;
+		bandAt(band, row, n * 2 + 1) = ks[n];
+		bandAt(band, row, n * 2 + 2) = ks[n + 1];
+		rhs[row * 2] = (ks[n] + ks[n + 1]) * p.x;
+		rhs[row * 2 + 1] = (ks[n] + ks[n + 1]) * p.y;
+	}
+	
+	bandAt(band, size - 1, size - 1) = 1;
+	rhs[size * 2 - 2] = points[curvesNum].x - vf.x / (3.0 * ks[curvesNum - 1]);
+	rhs[size * 2 - 1] = points[curvesNum].y - vf.y / (3.0 * ks[curvesNum - 1]);
+	
+	// Gaussian elimination with partial pivoting.  Only the next row has anything
+	// below the diagonal, so it's the only candidate pivot.
+	for (int c = 0; c < size - 1; c++)
+	{
+		const int last = min(c + 3, size - 1);
 		
-		int i = 2;
-		for (int n=0; n<curvesNum-1; n++) 
+		if (fabs(bandAt(band, c + 1, c)) > fabs(bandAt(band, c, c)))
 		{
-			equations(i, n*2 + 1) = ks[n];
-			equations(i, n*2 + 2) = ks[n+1];
-			answer(i) = (ks[n] + ks[n+1]) * points[n + 1];
-			i++;
+			for (int j = c; j <= last; j++)
+			{
+				swap(bandAt(band, c, j), bandAt(band, c + 1, j));
+			}
+			swap(rhs[c * 2], rhs[c * 2 + 2]);
+			swap(rhs[c * 2 + 1], rhs[c * 2 + 3]);
 		}
-
 		
-		for (int n=0; n<curvesNum-1; n++) 
+		double f = bandAt(band, c + 1, c) / bandAt(band, c, c);
+		if (f != 0)
 		{
-
-			equations(i, n*2) = ks2[n];
-			equations(i, n*2 + 1) = -2*ks2[n];
-			equations(i, n*2 + 2) = 2*ks2[n+1];
-			equations(i, n*2 + 3) = -ks2[n+1];
-			answer(i) = points[n + 1] * (ks2[n+1] - ks2[n]); 
-			i++;
+			for (int j = c; j <= last; j++)
+			{
+				bandAt(band, c + 1, j) -= f * bandAt(band, c, j);
+			}
+			rhs[c * 2 + 2] -= f * rhs[c * 2];
+			rhs[c * 2 + 3] -= f * rhs[c * 2 + 1];
 		}
-		
-		ColPivHouseholderQR<MatrixXd> solver(equations);
-		VectorXd solution = solver.solve(answer);
-		return solution;
+	}
+	
+	// Back substitution, leaving the solution in rhs
+	for (int c = size - 1; c >= 0; c--)
+	{
+		double x = rhs[c * 2];
+		double y = rhs[c * 2 + 1];
+		for (int j = c + 1; j <= min(c + 3, size - 1); j++)
+		{
+			x -= bandAt(band, c, j) * rhs[j * 2];
+			y -= bandAt(band, c, j) * rhs[j * 2 + 1];
+		}
+		rhs[c * 2] = x / bandAt(band, c, c);
+		rhs[c * 2 + 1] = y / bandAt(band, c, c);
+	}
+	
+	controls.resize(size);
+	for (int i = 0; i < size; i++)
+	{
+		controls[i] = Geometry2d::Point(rhs[i * 2], rhs[i * 2 + 1]);
 	}
 }
@@ -2,28 +2,40 @@
 #pragma once
 
 #include <list>
+#include <vector>
 #include <Geometry2d/Point.hpp>
 #include <Geometry2d/CompositeShape.hpp>
 #include <planning/Path.hpp>
+#include <planning/ObstacleWorld.hpp>
 #include <MotionConstraints.hpp>
+#include <time.hpp>
 
 #include "Tree.hpp"
 
 namespace Planning
 {
-	/** generate a random point on the floor */
-	Geometry2d::Point randomPoint();
+	/** generate a random point on the floor
+	 *  @a state is the erand48() state, so each caller can have its own */
+	Geometry2d::Point randomPoint(unsigned short state[3]);
 
 	/**
 	 * @brief Given a start point and an end point and some conditions, plans a path for a robot to get there.
 	 * 
 	 * @details There are many ways to plan paths.  This planner uses bidirectional [RRTs](http://en.wikipedia.org/wiki/Rapidly-exploring_random_tree).
 	 * You can check out our interactive RRT applet on GitHub here: https://github.com/RoboJackets/rrt.
+	 *
+	 * In ERRT mode (execution-extended RRT), samples are drawn from the other tree's root and
+	 * from a cache of waypoints on earlier paths as well as uniformly from the floor, and the
+	 * start tree is seeded with the part of the last path that is still ahead and clear.
+	 * Since the obstacles usually don't change much between frames, this finds a path in
+	 * fewer iterations and keeps it from jumping around.
 	 */
 	class RRTPlanner
 	{
 		public:
 			RRTPlanner();
+			
+			static void createConfiguration(Configuration *cfg);
 			/**
 			 * gets the maximum number of iterations for the RRT algorithm
 			 */
@@ -39,6 +51,24 @@ namespace Planning
 				_maxIterations = value;
 			}
 			
+			/**
+			 * gets the monotonicTimestamp() at which planning stops, or zero for no limit
+			 */
+			Time deadline() const
+			{
+				return _deadline;
+			}
+			
+			/**
+			 * sets when planning has to stop.  With a deadline the planner is anytime:
+			 * it stops searching when time runs out and returns the best path it has, and if
+			 * it finds a path early it spends the rest of the time shortening it.
+			 */
+			void deadline(Time value)
+			{
+				_deadline = value;
+			}
+			
 			///run the path ROTplanner
 			///this will always populate path to be the path we need to travel
 			void run(
@@ -46,12 +76,48 @@ namespace Planning
 					const float angle, 
 					const Geometry2d::Point& vel, 
 					const MotionConstraints &motionConstraints,
-					const Geometry2d::CompositeShape* obstacles, 
+					const ObstacleWorld* obstacles, 
+					Planning::Path &path);
+			
+			/**
+			 * Tries to fix the last path planned by run() after it became blocked,
+			 * without planning all of it again.
+			 *
+			 * The blocked part of the path is replaced by an RRT from @start to the
+			 * first waypoint past the blockage, and the rest of the old waypoints are kept.
+			 *
+			 * @return false if there's no old path to the same goal, the rest of the old path
+			 *         is also blocked, or the trees don't connect.  Use run() in that case.
+			 */
+			bool repair(
+					const Geometry2d::Point& start,
+					const Geometry2d::Point& vel,
+					const MotionConstraints &motionConstraints,
+					const ObstacleWorld* obstacles,
 					Planning::Path &path);
 			
+			/** returns the number of RRT iterations used by the last run() or repair() */
+			int iterations() const { return _iterations; }
+			
 			/** returns the length of the best position planned path */
 			float fixedPathLength() const { return _bestPath.length(); }
 			
+			/**
+			 * Helper function for cubicBezier() which solves for the middle two control
+			 * points of each curve so that the curves join with continuous velocity and
+			 * acceleration.
+			 *
+			 * The equations only relate neighboring curves, so they are solved as a banded
+			 * system in O(n), for x and y at the same time.
+			 *
+			 * @param ks is the inverse of the time taken by each curve, and ks2 its square
+			 * @param controls is set to the control points, two for each curve in order
+			 */
+			static void cubicBezierCalc(Geometry2d::Point vi, Geometry2d::Point vf,
+					const std::vector<Geometry2d::Point> &points,
+					const std::vector<double> &ks, const std::vector<double> &ks2,
+					std::vector<Geometry2d::Point> &controls);
+			
 	protected:
 		MotionConstraints _motionConstraints;
 
@@ -65,36 +131,81 @@ namespace Planning
 		///this is a fixed step path
 		Planning::Path _bestPath;
 		
+		///waypoints of _bestPath before smoothing, for repair()
+		std::vector<Geometry2d::Point> _waypoints;
+		
+		///the goal requested by the last call to run()
+		Geometry2d::Point _goal;
+		
 		Geometry2d::Point vi;
 		///maximum number of rrt iterations to run
 		///this does not include connect attempts
 		unsigned int _maxIterations;
 		
+		///iterations used by the last connectTrees()
+		int _iterations;
+		
+		///monotonicTimestamp() to stop planning at, or zero
+		Time _deadline;
+		
 		///latest obstacles
-		const Geometry2d::CompositeShape* _obstacles;
+		const ObstacleWorld* _obstacles;
+		
+		///random number state for this planner.
+		///planners for different robots may run at the same time, so they can't share drand48().
+		unsigned short _randomState[3];
+		
+		///waypoints from earlier paths, sampled from in ERRT mode
+		std::vector<Geometry2d::Point> _waypointCache;
+		
+		static ConfigBool *_errt;
+		static ConfigDouble *_goalBias;
+		static ConfigDouble *_waypointBias;
+		static ConfigInt *_waypointCacheSize;
+		
+		static ConfigInt *_refineAttempts;
+		
+		/** true if there's a deadline and it has passed */
+		bool pastDeadline() const;
+		
+		/** shortens @a points by connecting random points on different segments directly,
+		 *  until the deadline or until RRT/Refine Attempts tries in a row don't help */
+		void refine(std::vector<Geometry2d::Point> &points, const ObstacleWorld *obstacles);
+		
+		/** picks the next point for a tree to grow towards.
+		 *  @a target is the root of the other tree, used for goal bias */
+		Geometry2d::Point sample(const Geometry2d::Point &target);
+		
+		/** adds the waypoints of a new path to the cache, replacing random old ones when it's full */
+		void cacheWaypoints(const std::vector<Geometry2d::Point> &points);
+		
+		/** adds the part of the last path that's ahead of the start tree's root to that tree,
+		 *  as far as it's still clear.  Only done if the last path ended at @a goal.
+		 *  returns the last point added, or 0 if none were. */
+		Tree::Point* seedFromLastPath(const Geometry2d::Point &goal);
+		
+		/** grows trees from @start and @goal towards each other
+		 *  and makes an unsmoothed path from the result with makePath() */
+		bool connectTrees(const Geometry2d::Point &start, const Geometry2d::Point &goal, Planning::Path &path);
 		
 		/** makes a path from the last point of each tree
 		 *  If the points don't match up...fail!
 		 *  The final path will be from the start of tree0
 		 *  to the start of tree1 */
-		void makePath();
+		bool makePath(Planning::Path &path);
 		
 		/** optimize the path 
 		 *  Calles the cubicBezier optimization function.
 		 */
-		void optimize(Planning::Path &path, const Geometry2d::CompositeShape *obstacles);
+		void optimize(Planning::Path &path, const ObstacleWorld *obstacles);
 
 		/**
 		 * Uses a cubicBezier to interpolate between the points on the path and add
 		 * velocity planning
 		 */
-		void cubicBezier(Planning::Path &path, const Geometry2d::CompositeShape *obstacles);
-
-		/**
-		 * Helper function for cubicBezier() which uses Eigen matrices to solve for the 
-		 * cubic bezier equations.
-		 */
-		Eigen::VectorXd cubicBezierCalc (double vi, double vf, std::vector<double> &points, 
-									std::vector<double> &ks, std::vector<double> &ks2);
+		void cubicBezier(Planning::Path &path, const ObstacleWorld *obstacles);
+		
+		///control points from cubicBezierCalc(), kept so that it doesn't allocate every plan
+		std::vector<Geometry2d::Point> _controls;
 	};
 }
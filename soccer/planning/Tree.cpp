@@ -4,39 +4,31 @@
 
 #include <stdio.h>
 #include <iostream>
+#include <math.h>
 
 using namespace Planning;
 using namespace std;
 
 //// Point ////
-Tree::Point::Point(const Geometry2d::Point& p, Tree::Point* parent) :
+Tree::Point::Point(Tree *tree, int index, const Geometry2d::Point& p, int parent) :
 	pos(p)
 {
+	_tree = tree;
+	_index = index;
 	_parent = parent;
 	leaf = true;
-	
-	if (_parent)
-	{
-		_parent->children.push_back(this);
-		_parent->leaf = false;
-	}
-}
-
-void Tree::Point::addEdges(std::list<Geometry2d::Segment>& edges)
-{
-	for (Tree::Point* next :  children)
-	{
-		edges.push_back(Geometry2d::Segment(pos, next->pos));
-		next->addEdges(edges);
-	}
 }
 
 //// Tree ////
 
+const float Tree::CellSize = 0.5;
+
 Tree::Tree()
 {
 	step = .1;
 	_obstacles = 0;
+	_gridMinX = _gridMinY = 0;
+	_gridWidth = _gridHeight = 0;
 }
 
 Tree::~Tree()
@@ -46,31 +38,89 @@ Tree::~Tree()
 
 void Tree::clear()
 {
-	 _obstacles = 0;
-
-    // Delete all points
-    for (Point *pt :  points)
-    {
-        delete pt;
-    }
-    points.clear();
+	_obstacles = 0;
+	
+	// Storage is kept for the next init()
+	_nodes.clear();
+	_x.clear();
+	_y.clear();
+	_next.clear();
+	_cellHead.clear();
 }
 
-void Tree::init(const Geometry2d::Point& start, const Geometry2d::CompositeShape* obstacles)
+void Tree::init(const Geometry2d::Point& start, const ObstacleWorld* obstacles)
 {
 	clear();
 	
 	_obstacles = obstacles;
 	
-	Point* p = new Point(start, 0);
+	// The grid covers the area that randomPoint() samples from
+	const Field_Dimensions &dims = Field_Dimensions::Current_Dimensions;
+	_gridMinX = -dims.FloorWidth() / 2;
+	_gridMinY = -dims.Border();
+	_gridWidth = max(1, (int)ceilf(dims.FloorWidth() / CellSize));
+	_gridHeight = max(1, (int)ceilf(dims.FloorLength() / CellSize));
+	_cellHead.assign(_gridWidth * _gridHeight, -1);
+	
+	Point* p = addPoint(start, -1);
 	_obstacles->hit(p->pos, p->hit);
-	points.push_back(p);
+}
+
+int Tree::cellIndex(float x, float y) const
+{
+	int cx = min(_gridWidth - 1, max(0, (int)floorf((x - _gridMinX) / CellSize)));
+	int cy = min(_gridHeight - 1, max(0, (int)floorf((y - _gridMinY) / CellSize)));
+	return cy * _gridWidth + cx;
+}
+
+Tree::Point* Tree::addPoint(const Geometry2d::Point& pos, int parent)
+{
+	int i = _nodes.size();
+	_nodes.push_back(Point(this, i, pos, parent));
+	_x.push_back(pos.x);
+	_y.push_back(pos.y);
+	
+	int cell = cellIndex(pos.x, pos.y);
+	_next.push_back(_cellHead[cell]);
+	_cellHead[cell] = i;
+	
+	if (parent >= 0)
+	{
+		_nodes[parent].leaf = false;
+	}
+	
+	return &_nodes[i];
+}
+
+Tree::Point* Tree::addIfClear(const Geometry2d::Point& pos, Point* base)
+{
+	// If this move touches any obstacles that the starting point didn't already touch,
+	// it has entered an obstacle and will be rejected.
+	if (_obstacles->hitNew(Geometry2d::Segment(pos, base->pos), base->hit))
+	{
+		return 0;
+	}
+	
+	Point* p = addPoint(pos, base->index());
+	_obstacles->hit(p->pos, p->hit);
+	return p;
+}
+
+void Tree::addEdges(std::list<Geometry2d::Segment>& edges) const
+{
+	for (const Point &pt :  _nodes)
+	{
+		if (pt._parent >= 0)
+		{
+			edges.push_back(Geometry2d::Segment(_nodes[pt._parent].pos, pt.pos));
+		}
+	}
 }
 
 void Tree::addPath(Planning::Path &path, Point* dest, const bool rev)
 {
 	list<Point *> points;
-
+	
 	int n = 0;
 	while (dest)
 	{
@@ -91,44 +141,123 @@ void Tree::addPath(Planning::Path &path, Point* dest, const bool rev)
 	{
 		path.points.push_back(pt->pos);
 	}
+	path.invalidate();
 }
 
 Tree::Point* Tree::nearest(Geometry2d::Point pt)
 {
-	float bestDistance = -1;
-    Point *best = 0;
-    
-    for (Point* other :  points)
-    {
-        float d = (other->pos - pt).magsq();
-        if (bestDistance < 0 || d < bestDistance)
-        {
-            bestDistance = d;
-            best = other;
-        }
-    }
-
-    return best;
+	int n = _nodes.size();
+	if (n == 0)
+	{
+		return 0;
+	}
+	
+	int best = 0;
+	float bestDistance = INFINITY;
+	
+	if (n < LinearSearchLimit)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			float dx = _x[i] - pt.x;
+			float dy = _y[i] - pt.y;
+			float d = dx * dx + dy * dy;
+			if (d < bestDistance)
+			{
+				bestDistance = d;
+				best = i;
+			}
+		}
+		
+		return &_nodes[best];
+	}
+	
+	// Search rings of cells around the query's cell until the closest point
+	// found so far is nearer than anything outside the searched box could be.
+	int cell = cellIndex(pt.x, pt.y);
+	int cx = cell % _gridWidth;
+	int cy = cell / _gridWidth;
+	int maxRing = max(max(cx, _gridWidth - 1 - cx), max(cy, _gridHeight - 1 - cy));
+	
+	for (int r = 0; r <= maxRing; ++r)
+	{
+		int x0 = cx - r, x1 = cx + r;
+		int y0 = cy - r, y1 = cy + r;
+		
+		for (int y = max(0, y0); y <= min(_gridHeight - 1, y1); ++y)
+		{
+			// Interior rows only have cells on the left and right edges of the ring
+			bool edgeRow = (y == y0 || y == y1);
+			int dx = edgeRow ? 1 : (x1 - x0);
+			for (int x = x0; x <= x1; x += max(1, dx))
+			{
+				if (x < 0 || x >= _gridWidth)
+				{
+					continue;
+				}
+				
+				for (int i = _cellHead[y * _gridWidth + x]; i >= 0; i = _next[i])
+				{
+					float ex = _x[i] - pt.x;
+					float ey = _y[i] - pt.y;
+					float d = ex * ex + ey * ey;
+					if (d < bestDistance)
+					{
+						bestDistance = d;
+						best = i;
+					}
+				}
+			}
+		}
+		
+		// Distance from the query to the nearest side of the searched box that
+		// has unsearched cells beyond it.  Sides on the grid boundary don't count
+		// because points past the boundary are stored in the edge cells.
+		float bound = INFINITY;
+		if (x0 > 0)
+		{
+			bound = min(bound, pt.x - (_gridMinX + x0 * CellSize));
+		}
+		if (x1 < _gridWidth - 1)
+		{
+			bound = min(bound, _gridMinX + (x1 + 1) * CellSize - pt.x);
+		}
+		if (y0 > 0)
+		{
+			bound = min(bound, pt.y - (_gridMinY + y0 * CellSize));
+		}
+		if (y1 < _gridHeight - 1)
+		{
+			bound = min(bound, _gridMinY + (y1 + 1) * CellSize - pt.y);
+		}
+		
+		if (bestDistance <= bound * bound)
+		{
+			break;
+		}
+	}
+	
+	return &_nodes[best];
 }
 
-Tree::Point* Tree::start() const
+Tree::Point* Tree::start()
 {
-	if (points.empty())
+	if (_nodes.empty())
 	{
 		return 0;
 	}
 	
-	return points.front();
+	return &_nodes.front();
 }
 
-Tree::Point* Tree::last() const
+Tree::Point* Tree::last()
 {
-	if (points.empty())
+	if (_nodes.empty())
 	{
 		return 0;
 	}
 	
-	return points.back();
+	return &_nodes.back();
 }
 
 //// Fixed Step Tree ////
@@ -157,33 +286,9 @@ Tree::Point* FixedStepTree::extend(Geometry2d::Point pt, Tree::Point* base)
 		pos = base->pos + delta / d * step;
 	}
 	
-	// Check for obstacles.
-	
-	// moveHit is the set of obstacles that this move touches.
-	// If this move touches any obstacles that the starting point didn't already touch,
-	// it has entered an obstacle and will be rejected.
-	std::set<shared_ptr<Geometry2d::Shape> > moveHit;
-	if (_obstacles->hit(Geometry2d::Segment(pos, base->pos), moveHit))
-	{
-		// We only care if there are any items in moveHit that are not in point->hit, so
-		// we don't store the result of set_difference.
-		try
-		{
-			set_difference(moveHit.begin(), moveHit.end(), base->hit.begin(), 
-				base->hit.end(), ExceptionIterator<std::shared_ptr<Geometry2d::Shape>>());
-		} catch (exception& e)
-		{
-			// We hit a new obstacle
-			return 0;
-		}
-	}
-	
-	// Allow this point to be added to the tree
-	Point* p = new Point(pos, base);
-	_obstacles->hit(p->pos, p->hit);
-	points.push_back(p);
-	
-	return p;
+	// Check for obstacles and add the point if it's allowed.
+	// This invalidates base.
+	return addIfClear(pos, base);
 }
 
 bool FixedStepTree::connect(Geometry2d::Point pt)
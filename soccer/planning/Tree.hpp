@@ -1,14 +1,21 @@
 #pragma once
 
 #include <list>
+#include <memory>
+#include <vector>
 
 #include <Geometry2d/Segment.hpp>
 #include <planning/Path.hpp>
+#include <planning/ObstacleWorld.hpp>
 
 namespace Planning
 {
 	/** base tree class for rrt trees
-	 *  Tree can be grown in different ways */
+	 *  Tree can be grown in different ways
+	 *
+	 *  Points are stored contiguously and refer to their parents by index.
+	 *  Adding a point may move the others, so a Point* is only valid until
+	 *  the next call to extend(), connect(), or init(). */
 	class Tree
 	{
 		public:
@@ -17,26 +24,32 @@ namespace Planning
 			class Point
 			{
 				public:
-					Point(const Geometry2d::Point& pos, Point* parent);
-					
 					//field position of the point
 					Geometry2d::Point pos;
 					
 					// Which obstacles contain this point
-					std::set<std::shared_ptr<Geometry2d::Shape>> hit;
+					Geometry2d::ShapeSet hit;
 					
 					//velocity information (used by dynamic tree)
 					Geometry2d::Point vel;
 					
 					bool leaf;
 					
-					inline Point* parent() const { return _parent; }
-					
-					void addEdges(std::list<Geometry2d::Segment>& edges);
+					inline Point* parent() const;
 					
+					/** position of this point in the tree's node store */
+					int index() const { return _index; }
+				
 				private:
-					std::list<Point *> children;
-					Point* _parent;
+					friend class Tree;
+					
+					Point(Tree *tree, int index, const Geometry2d::Point& pos, int parent);
+					
+					Tree *_tree;
+					int _index;
+					
+					// Index of the parent point, or -1 for the root
+					int _parent;
 			};
 			
 			Tree();
@@ -45,7 +58,7 @@ namespace Planning
 			/** cleanup the tree */
 			void clear();
 			
-			void init(const Geometry2d::Point &start, const Geometry2d::CompositeShape *obstacles);
+			void init(const Geometry2d::Point &start, const ObstacleWorld *obstacles);
 			
 			/** find the point of the tree closest to @a pt */
 			Point* nearest(Geometry2d::Point pt);
@@ -58,25 +71,67 @@ namespace Planning
 			/** attempt to connect the tree to the point */
 			virtual bool connect(const Geometry2d::Point pt) = 0;
 			
+			/** adds @a pos as a child of @a base in one step, however far away it is.
+			 *  returns the new point, or 0 if the move would enter an obstacle */
+			Point* addIfClear(const Geometry2d::Point &pos, Point* base);
+			
 			/** make a path from the dest point's root to the dest point
 			 *  If rev is true, the path will be from the dest point to its root */
 			void addPath(Planning::Path &path, Point* dest, const bool rev = false);
 			
+			/** adds a segment from each point to its parent */
+			void addEdges(std::list<Geometry2d::Segment>& edges) const;
+			
 			/** returns the first point or 0 if none */
-			Point* start() const;
+			Point* start();
 			
 			/** last point added */
-			Point* last() const;
+			Point* last();
+			
+			/** number of points in the tree */
+			int size() const { return _nodes.size(); }
+			
+			Point* point(int i) { return &_nodes[i]; }
 			
 			/** tree step size...interpreted differently for different trees */
 			float step;
+		
+		protected:
+			/** adds a point to the node store and the nearest-neighbour grid.
+			 *  Invalidates all existing Point pointers. */
+			Point* addPoint(const Geometry2d::Point &pos, int parent);
 			
-			std::list<Point*> points;
+			const ObstacleWorld* _obstacles;
+		
+		private:
+			// Size of a grid cell in meters
+			static const float CellSize;
 			
-		protected:
-			const Geometry2d::CompositeShape* _obstacles;
+			// Trees smaller than this are searched linearly instead of through the grid
+			static const int LinearSearchLimit = 64;
+			
+			int cellIndex(float x, float y) const;
+			
+			std::vector<Point> _nodes;
+			
+			// Positions of _nodes, kept separately so nearest() scans packed floats
+			std::vector<float> _x;
+			std::vector<float> _y;
+			
+			// Uniform grid over the floor.  Each cell is a singly linked list of
+			// point indices threaded through _next, with -1 as the terminator.
+			// Points outside the floor are stored in the nearest edge cell.
+			std::vector<int> _cellHead;
+			std::vector<int> _next;
+			float _gridMinX, _gridMinY;
+			int _gridWidth, _gridHeight;
 	};
 	
+	Tree::Point* Tree::Point::parent() const
+	{
+		return (_parent < 0) ? 0 : &_tree->_nodes[_parent];
+	}
+	
 	/** tree that grows based on fixed distance step */
 	class FixedStepTree : public Tree
 	{
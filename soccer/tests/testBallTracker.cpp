@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <modeling/BallTracker.hpp>
+#include <SystemState.hpp>
+#include <Constants.hpp>
+#include <protobuf/LogFrame.pb.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace Geometry2d;
+
+static const Time Start = 1000000;
+static const Time Period = 16667;
+
+// Runs the tracker on one frame of observations, all at @time
+static void run(BallTracker &tracker, SystemState &state, const vector<Point> &points, Time time)
+{
+	vector<BallObservation> obs;
+	for (const Point &pt : points)
+	{
+		obs.push_back(BallObservation(pt, time));
+	}
+	state.logFrame->set_command_time(time);
+	tracker.run(obs, &state);
+}
+
+/* ************************************************************************* */
+TEST( testBallTracker, confirm ) {
+	SystemState state;
+	state.logFrame = make_shared<Packet::LogFrame>();
+	BallTracker tracker;
+
+	// Seen by two cameras from the first frame
+	const Point ball(0.5, 2);
+	for (int i = 0; i < 3; ++i)
+	{
+		run(tracker, state, {ball, ball + Point(0.002, 0)}, Start + i * Period);
+		EXPECT_EQ(1, tracker.numTracks());
+		EXPECT_EQ(i == 2, state.ball.valid);
+	}
+	EXPECT_NEAR(0, state.ball.pos.distTo(ball), 0.01);
+}
+
+/* ************************************************************************* */
+TEST( testBallTracker, falsePositive ) {
+	SystemState state;
+	state.logFrame = make_shared<Packet::LogFrame>();
+	BallTracker tracker;
+
+	// A rolling ball, with something orange seen elsewhere for one frame
+	const Point falsePositive(-1, 4);
+	for (int i = 0; i < 60; ++i)
+	{
+		const Point ball(0.01f * i, 2);
+		vector<Point> points = {ball};
+		if (i == 10)
+		{
+			points.push_back(falsePositive);
+		}
+		run(tracker, state, points, Start + i * Period);
+
+		if (i >= 2)
+		{
+			EXPECT_EQ(1, tracker.numConfirmedTracks());
+			EXPECT_TRUE(state.ball.valid);
+			EXPECT_NEAR(0, state.ball.pos.distTo(ball), 0.02);
+		}
+	}
+}
+
+/* ************************************************************************* */
+TEST( testBallTracker, lostBall ) {
+	SystemState state;
+	state.logFrame = make_shared<Packet::LogFrame>();
+	BallTracker tracker;
+
+	for (int i = 0; i < 10; ++i)
+	{
+		run(tracker, state, {Point(0, 2)}, Start + i * Period);
+	}
+	EXPECT_TRUE(state.ball.valid);
+
+	// The ball isn't seen for long enough that its track is dropped.  The next thing seen
+	// may get the ball's old track slot, but it isn't the ball until it has been confirmed.
+	const Point shirt(-1, 4);
+	const Time later = Start + 10 * Period + 1000000;
+	for (int i = 0; i < 3; ++i)
+	{
+		run(tracker, state, {shirt}, later + i * Period);
+		EXPECT_EQ(1, tracker.numTracks());
+		EXPECT_EQ(i == 2, state.ball.valid);
+	}
+	EXPECT_NEAR(0, state.ball.pos.distTo(shirt), 0.01);
+}
+
+/* ************************************************************************* */
+TEST( testBallTracker, clutter ) {
+	SystemState state;
+	state.logFrame = make_shared<Packet::LogFrame>();
+	BallTracker tracker;
+
+	// Far more false positives than the tracker can follow, all over the field.
+	// The ball is reported first, as vision would if it were the best match.
+	const float width = Field_Dimensions::Current_Dimensions.Width();
+	const float length = Field_Dimensions::Current_Dimensions.Length();
+	srand48(1);
+	for (int i = 0; i < 120; ++i)
+	{
+		const Point ball(0.01f * i, 2);
+		vector<Point> points = {ball};
+		for (int j = 0; j < 100; ++j)
+		{
+			points.push_back(Point((drand48() - 0.5) * width, drand48() * length));
+		}
+		run(tracker, state, points, Start + i * Period);
+
+		EXPECT_LE(tracker.numTracks(), (int)BallTracker::Max_Tracks);
+		if (i >= 2)
+		{
+			EXPECT_TRUE(state.ball.valid);
+			EXPECT_NEAR(0, state.ball.pos.distTo(ball), 0.05);
+		}
+	}
+}
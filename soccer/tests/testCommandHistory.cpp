@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include <modeling/CommandHistory.hpp>
+#include <Utils.hpp>
+#include <math.h>
+
+using namespace Geometry2d;
+
+// Forward speed commanded at @t seconds: always changing, so only the right delay lines up
+static float commandSpeed(float t)
+{
+	return 1 + sinf(t * 3) + 0.5f * sinf(t * 7.3f);
+}
+
+/* ************************************************************************* */
+TEST( testCommandHistory, latency ) {
+	CommandHistory history;
+	const unsigned int shell = 2;
+	const Time start = 1000000;
+	const int delay = 5;
+
+	EXPECT_EQ(12345u, history.latency(12345));
+
+	// Commands at 100Hz, with the robot facing +y so body x is world y.
+	// Vision sees the robot doing what it was told 50ms earlier.
+	for (int i = 0; i < 600; ++i)
+	{
+		const Time time = start + i * 10000;
+		history.add(shell, time, Point(commandSpeed(i / 100.0f), 0), 0);
+
+		RobotPose pose;
+		pose.angle = M_PI / 2;
+		pose.vel = Point(0, commandSpeed((i - delay) / 100.0f));
+		history.observe(shell, time, pose);
+	}
+
+	EXPECT_EQ(50000u, history.latency(0));
+}
+
+/* ************************************************************************* */
+TEST( testCommandHistory, predict ) {
+	CommandHistory history;
+	const unsigned int shell = 5;
+	const Time start = 1000000;
+	const Time latency = 50000;
+
+	// Told to stop at start, after driving forward and turning
+	for (int i = 0; i < 10; ++i)
+	{
+		history.add(shell, start - (10 - i) * 10000, Point(1, 0), 2);
+	}
+	history.add(shell, start, Point(), 0);
+
+	// Seen at start, still moving.  It keeps going until the stop takes effect.
+	RobotPose pose;
+	pose.vel = Point(1, 0);
+	pose.angleVel = 2;
+	history.predict(shell, start, start + 100000, latency, pose);
+
+	EXPECT_NEAR(0.1, pose.angle, 0.001);
+	EXPECT_NEAR(0.05 * cosf(0.05), pose.pos.x, 0.002);
+	EXPECT_NEAR(0.05 * sinf(0.05), pose.pos.y, 0.002);
+	EXPECT_NEAR(0, pose.vel.mag(), 0.001);
+	EXPECT_NEAR(0, pose.angleVel, 0.001);
+
+	// Another robot that hasn't been sent anything keeps its own velocity
+	RobotPose other;
+	other.vel = Point(0, 2);
+	history.predict(shell + 1, start, start + 100000, latency, other);
+	EXPECT_NEAR(0.2, other.pos.y, 0.001);
+}
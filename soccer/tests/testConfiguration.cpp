@@ -0,0 +1,24 @@
+#include <gtest/gtest.h>
+#include <Configuration.hpp>
+
+// Gives every configurable its default settings, as if there were no config file,
+// before any test runs.  Many classes read their settings through static pointers
+// that are only set by createConfiguration().
+class ConfigurationEnvironment: public ::testing::Environment
+{
+public:
+	virtual void SetUp()
+	{
+		// Made here rather than during static initialization, since it's a QObject
+		_config = new Configuration();
+		for (Configurable *obj : Configurable::configurables())
+		{
+			obj->createConfiguration(_config);
+		}
+	}
+
+private:
+	Configuration *_config;
+};
+
+static ::testing::Environment *const configurationEnvironment = ::testing::AddGlobalTestEnvironment(new ConfigurationEnvironment);
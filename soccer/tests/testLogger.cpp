@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include <Logger.hpp>
+#include <set>
+
+using namespace std;
+using namespace Packet;
+
+// Adds frames until the history is full and makes sure the writer thread is done with them.
+// Returns the frames that were allocated.
+static set<LogFrame *> fill(Logger &logger)
+{
+	set<LogFrame *> frames;
+	for (int i = 0; i < logger.maxFrames(); ++i)
+	{
+		shared_ptr<LogFrame> frame = logger.createFrame();
+		frame->set_command_time(i);
+		frames.insert(frame.get());
+		logger.addFrame(frame);
+	}
+
+	logger.close();
+	return frames;
+}
+
+/* ************************************************************************* */
+TEST( testLogger, recycle ) {
+	// The shortest history allowed
+	Logger logger(1);
+
+	// Warm-up: every frame is new until the history is full
+	set<LogFrame *> allocated = fill(logger);
+	EXPECT_EQ(logger.maxFrames(), (int)allocated.size());
+
+	// After the first frame past the end of the history, createFrame() gives back
+	// frames that fell out of the history, cleared
+	for (int i = 0; i < 10; ++i)
+	{
+		shared_ptr<LogFrame> frame = logger.createFrame();
+		if (i > 0)
+		{
+			EXPECT_EQ(1u, allocated.count(frame.get()));
+			EXPECT_FALSE(frame->has_command_time());
+		}
+		logger.addFrame(frame);
+	}
+}
+
+/* ************************************************************************* */
+TEST( testLogger, heldFrame ) {
+	Logger logger(1);
+	fill(logger);
+
+	// A reader holds on to the oldest frame
+	vector<shared_ptr<LogFrame> > frames(1);
+	ASSERT_EQ(1, logger.getFrames(logger.firstFrameNumber(), frames));
+	LogFrame *held = frames[0].get();
+
+	// It isn't reused while the reader has it, even after it leaves the history
+	for (int i = 0; i < 3; ++i)
+	{
+		shared_ptr<LogFrame> frame = logger.createFrame();
+		EXPECT_NE(held, frame.get());
+		logger.addFrame(frame);
+	}
+	logger.close();
+
+	// Once it is released, it comes back from createFrame()
+	frames[0].reset();
+	bool reused = false;
+	for (int i = 0; i < 3; ++i)
+	{
+		shared_ptr<LogFrame> frame = logger.createFrame();
+		reused = reused || frame.get() == held;
+	}
+	EXPECT_TRUE(reused);
+}
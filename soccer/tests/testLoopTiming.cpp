@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include <LoopTiming.hpp>
+
+using namespace Packet;
+
+/* ************************************************************************* */
+TEST( testLoopTiming, percentiles ) {
+	LoopTimingStats stats;
+
+	// Totals of 1..100 us, with one outlier at 10ms
+	for (int i = 1; i <= 100; ++i)
+	{
+		LoopTiming timing;
+		timing.set_total(i == 100 ? 10000 : i);
+		stats.add(timing);
+	}
+
+	LoopTimingStats::Summary summaries[LoopTimingStats::NumStages];
+	stats.summarize(summaries);
+
+	const LoopTimingStats::Summary &total = summaries[LoopTimingStats::Total];
+	EXPECT_EQ(51, total.p50);
+	EXPECT_EQ(10000, total.p99);
+	EXPECT_EQ(10000, total.max);
+
+	// Stages that were never set are zero
+	EXPECT_EQ(0, summaries[LoopTimingStats::Vision].max);
+}
+
+/* ************************************************************************* */
+TEST( testLoopTiming, window ) {
+	LoopTimingStats stats;
+
+	// Old samples fall out of the window
+	for (int i = 0; i < LoopTimingStats::Window; ++i)
+	{
+		LoopTiming timing;
+		timing.set_models(5000);
+		stats.add(timing);
+	}
+	for (int i = 0; i < LoopTimingStats::Window; ++i)
+	{
+		LoopTiming timing;
+		timing.set_models(100);
+		stats.add(timing);
+	}
+
+	LoopTimingStats::Summary summaries[LoopTimingStats::NumStages];
+	stats.summarize(summaries);
+	EXPECT_EQ(100, summaries[LoopTimingStats::Models].max);
+}
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <planning/ObstacleWorld.hpp>
+#include <Geometry2d/Circle.hpp>
+#include <Geometry2d/Rect.hpp>
+#include <Geometry2d/Polygon.hpp>
+#include <stdlib.h>
+
+using namespace Geometry2d;
+using namespace Planning;
+
+static Point randomPoint()
+{
+	return Point(drand48() * 8 - 4, drand48() * 8 - 4);
+}
+
+/* ************************************************************************* */
+TEST( testObstacleWorld, matchesCompositeShape ) {
+	CompositeShape shapes;
+	shapes.add(std::make_shared<Circle>(Point(0, 0), 0.5));
+	shapes.add(std::make_shared<Rect>(Point(1, 1), Point(2, 3)));
+
+	std::shared_ptr<Polygon> triangle = std::make_shared<Polygon>();
+	triangle->vertices.push_back(Point(-3, -3));
+	triangle->vertices.push_back(Point(-1, -3));
+	triangle->vertices.push_back(Point(-2, -1));
+	shapes.add(triangle);
+
+	// Nested composites count as one shape
+	std::shared_ptr<CompositeShape> nested = std::make_shared<CompositeShape>();
+	nested->add(std::make_shared<Circle>(Point(2, -2), 0.3));
+	nested->add(std::make_shared<Rect>(Point(-3, 2), Point(-2, 2.5)));
+	shapes.add(nested);
+
+	ObstacleWorld world(shapes);
+	ASSERT_EQ(4, world.size());
+
+	srand48(2);
+	for (int i = 0; i < 2000; ++i)
+	{
+		Point pt = randomPoint();
+		Segment seg(pt, randomPoint());
+
+		EXPECT_EQ(shapes.hit(pt), world.hit(pt));
+		EXPECT_EQ(shapes.hit(seg), world.hit(seg));
+
+		ShapeSet expected, actual;
+		shapes.hit(seg, expected);
+		world.hit(seg, actual);
+		EXPECT_EQ(expected, actual);
+
+		ShapeSet start;
+		shapes.hit(pt, start);
+		EXPECT_EQ(shapes.hitNew(seg, start), world.hitNew(seg, start));
+	}
+}
+
+/* ************************************************************************* */
+TEST( testObstacleWorld, incremental ) {
+	CompositeShape field;
+	field.add(std::make_shared<Rect>(Point(1, 1), Point(2, 3)));
+
+	// Built piece by piece as replanIfNeeded() does
+	ObstacleWorld world;
+	world.build(field);
+	world.clear();
+	world.addCircle(Point(0, 0), 0.5);
+	world.add(field);
+	ASSERT_EQ(2, world.size());
+
+	CompositeShape shapes;
+	shapes.add(std::make_shared<Circle>(Point(0, 0), 0.5));
+	shapes.add(field);
+
+	srand48(3);
+	for (int i = 0; i < 1000; ++i)
+	{
+		Segment seg(randomPoint(), randomPoint());
+
+		ShapeSet expected, actual;
+		shapes.hit(seg, expected);
+		world.hit(seg, actual);
+		EXPECT_EQ(expected, actual);
+	}
+}
+
+/* ************************************************************************* */
+TEST( testObstacleWorld, distanceField ) {
+	std::shared_ptr<Polygon> triangle = std::make_shared<Polygon>();
+	triangle->vertices.push_back(Point(-3, -3));
+	triangle->vertices.push_back(Point(-1, -3));
+	triangle->vertices.push_back(Point(-2, -1));
+
+	CompositeShape group;
+	group.add(std::make_shared<Circle>(Point(0, 0), 0.5));
+	group.add(triangle);
+
+	// The field is smaller than the random points so queries off of it are covered
+	DistanceField field;
+	field.build(group, Rect(Point(-3, -3), Point(3, 3)), 0.05);
+
+	ObstacleWorld world;
+	for (const std::shared_ptr<Shape> &shape : group)
+	{
+		world.add(shape.get(), &field);
+	}
+	ASSERT_EQ(2, world.size());
+
+	srand48(4);
+	int clear = 0;
+	for (int i = 0; i < 2000; ++i)
+	{
+		Point pt = randomPoint();
+		Segment seg(pt, randomPoint());
+
+		// The field may only say things are clear when they are
+		if (field.clear(pt))
+		{
+			EXPECT_FALSE(group.hit(pt));
+			++clear;
+		}
+		if (field.clear(seg))
+		{
+			EXPECT_FALSE(group.hit(seg));
+		}
+
+		EXPECT_EQ(group.hit(pt), world.hit(pt));
+
+		ShapeSet expected, actual;
+		group.hit(seg, expected);
+		world.hit(seg, actual);
+		EXPECT_EQ(expected, actual);
+	}
+
+	// Most of the field is far from the obstacles
+	EXPECT_GT(clear, 500);
+}
+
+/* ************************************************************************* */
+TEST( testObstacleWorld, manyShapes ) {
+	// More shapes than a ShapeSet has bits, so the last ones share a bit.
+	// Circles and rects alternate, spread along y = 0.
+	CompositeShape shapes;
+	const int count = ShapeSet().size() + 20;
+	for (int i = 0; i < count; ++i)
+	{
+		const Point center(i * 0.5f, 0);
+		if (i % 2)
+		{
+			shapes.add(std::make_shared<Rect>(center - Point(0.05, 0.05), center + Point(0.05, 0.05)));
+		} else {
+			shapes.add(std::make_shared<Circle>(center, 0.05));
+		}
+	}
+
+	ObstacleWorld world(shapes);
+	ASSERT_EQ(count, world.size());
+
+	// Starting in one shape past the last bit, moving into another.
+	// The start only excuses the shape it is in.
+	for (int from = ShapeSet().size(); from < count - 1; ++from)
+	{
+		const Point start(from * 0.5f, 0);
+		ShapeSet startHit;
+		shapes.hit(start, startHit);
+
+		const Segment out(start, start + Point(0, 1));
+		EXPECT_FALSE(shapes.hitNew(out, startHit));
+		EXPECT_FALSE(world.hitNew(out, startHit));
+
+		const Segment across(start, start + Point(0.5, 0));
+		EXPECT_TRUE(shapes.hitNew(across, startHit));
+		EXPECT_TRUE(world.hitNew(across, startHit));
+	}
+
+	// Random queries still agree
+	srand48(5);
+	for (int i = 0; i < 2000; ++i)
+	{
+		Point pt(drand48() * count * 0.5f, drand48() * 0.4 - 0.2);
+		Segment seg(pt, Point(drand48() * count * 0.5f, drand48() * 0.4 - 0.2));
+
+		ShapeSet start;
+		shapes.hit(pt, start);
+		EXPECT_EQ(shapes.hitNew(seg, start), world.hitNew(seg, start));
+	}
+}
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include <modeling/OrientationFilter.hpp>
+#include <math.h>
+
+/* ************************************************************************* */
+TEST( testOrientationFilter, yaw ) {
+	// A quarter turn about z, not normalized
+	EXPECT_NEAR(M_PI / 2, OrientationFilter::yaw(2 * cosf(M_PI / 4), 0, 0, 2 * sinf(M_PI / 4)), 1e-5);
+	EXPECT_NEAR(0, OrientationFilter::yaw(1, 0, 0, 0), 1e-5);
+}
+
+/* ************************************************************************* */
+TEST( testOrientationFilter, delayedVision ) {
+	OrientationFilter filter;
+	const unsigned int shell = 4;
+	const Time start = 1000000;
+	const float angleVel = 2;
+
+	// The IMU's zero is 1 radian away from the field's
+	const float imuOffset = -1;
+
+	float angle, w;
+	EXPECT_FALSE(filter.predict(shell, start, angle, w));
+
+	// IMU at 60Hz, and vision of each frame arriving 80ms after it was captured
+	for (int i = 0; i < 120; ++i)
+	{
+		const Time now = start + i * 16667;
+		filter.imu(shell, now, fixAngleRadians(angleVel * i / 60.0f + imuOffset));
+
+		const int seen = i - 5;
+		if (seen >= 0)
+		{
+			filter.vision(shell, start + seen * 16667, fixAngleRadians(angleVel * seen / 60.0f));
+		}
+	}
+
+	// Angle now, not when vision last saw it
+	const Time now = start + 119 * 16667;
+	ASSERT_TRUE(filter.predict(shell, now, angle, w));
+	EXPECT_NEAR(angleVel, w, 0.01);
+	EXPECT_NEAR(0, fixAngleRadians(angleVel * 119 / 60.0f - angle), 0.01);
+
+	// A sudden turn shows up with the next IMU sample, before any vision
+	filter.imu(shell, now + 16667, fixAngleRadians(angleVel * 120 / 60.0f + imuOffset + 0.3f));
+	ASSERT_TRUE(filter.predict(shell, now + 16667, angle, w));
+	EXPECT_NEAR(0, fixAngleRadians(angleVel * 120 / 60.0f + 0.3f - angle), 0.01);
+
+	// IMU stopped
+	EXPECT_FALSE(filter.predict(shell, now + 1000000, angle, w));
+}
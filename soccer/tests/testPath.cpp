@@ -1,6 +1,7 @@
 #include <iostream>
 #include <gtest/gtest.h>
 #include <planning/Path.hpp>
+#include <Geometry2d/Circle.hpp>
 
 using namespace std;
 using namespace Geometry2d;
@@ -121,3 +122,91 @@ TEST(Path, evaluate) {
 	EXPECT_FALSE(pathValid);
 }
 
+
+/* ************************************************************************* */
+TEST( testPath, hit ) {
+	CompositeShape obstacles;
+	obstacles.add(std::make_shared<Circle>(Point(0, 0), 0.5));
+	obstacles.add(std::make_shared<Circle>(Point(2, 0), 0.5));
+	ObstacleWorld world(obstacles);
+
+	// Leaving the obstacle the path starts in is allowed
+	Planning::Path leave(Point(0, 0), Point(1, 0));
+	EXPECT_FALSE(leave.hit(world));
+
+	// Entering another one is not
+	Planning::Path enter(Point(0, 0), Point(3, 0));
+	EXPECT_TRUE(enter.hit(world));
+
+	// Neither is ending in one
+	Planning::Path end(Point(1, 0), Point(2, 0));
+	EXPECT_TRUE(end.hit(world));
+}
+
+/* ************************************************************************* */
+TEST( testPath, lengthTable ) {
+	Planning::Path path;
+	path.points.push_back(Point(0, 0));
+	path.points.push_back(Point(3, 0));
+	path.points.push_back(Point(3, 4));
+	path.points.push_back(Point(0, 4));
+
+	EXPECT_FLOAT_EQ(10, path.length());
+	EXPECT_FLOAT_EQ(7, path.length(1));
+	EXPECT_FLOAT_EQ(4, path.length(1, 2));
+	EXPECT_FLOAT_EQ(5, path.length(Point(3, 2)));
+
+	Point pos, dir;
+	EXPECT_TRUE(path.getPoint(5, pos, dir));
+	EXPECT_FLOAT_EQ(0, (pos - Point(3, 2)).mag());
+	EXPECT_FLOAT_EQ(0, (dir - Point(0, 1)).mag());
+	EXPECT_FALSE(path.getPoint(11, pos, dir));
+
+	// Changing the points rebuilds the table
+	path.points.push_back(Point(0, 0));
+	EXPECT_FLOAT_EQ(14, path.length());
+}
+
+/* ************************************************************************* */
+TEST( testPath, lengthTableMovedPoints ) {
+	Planning::Path path;
+	path.points.push_back(Point(0, 0));
+	path.points.push_back(Point(3, 0));
+	path.points.push_back(Point(3, 4));
+	path.points.push_back(Point(0, 4));
+	EXPECT_FLOAT_EQ(10, path.length());
+
+	// Moving interior points keeps the size and ends, so the table has to be invalidated
+	path.points[1] = Point(0, 2);
+	path.points[2] = Point(0, 3);
+	path.invalidate();
+	EXPECT_FLOAT_EQ(4, path.length());
+	EXPECT_FLOAT_EQ(1, path.length(1, 2));
+
+	Point pos, dir;
+	EXPECT_TRUE(path.getPoint(2.5, pos, dir));
+	EXPECT_FLOAT_EQ(0, (pos - Point(0, 2.5)).mag());
+}
+
+/* ************************************************************************* */
+TEST( testPath, evaluateAnyOrder ) {
+	Planning::Path path;
+	path.maxSpeed = 1;
+	path.maxAcceleration = 1;
+	for (int i = 0; i <= 20; ++i)
+	{
+		path.points.push_back(Point(i * 0.1, 0));
+		path.vels.push_back(Point(1, 0));
+		path.times.push_back(i * 0.1);
+	}
+
+	// Jumping around gives the same answers as going forward
+	const float ts[] = {0.05, 0.15, 1.55, 0.35, 0.36, 1.95, 0.0, 2.5};
+	for (float t : ts)
+	{
+		Point pos, vel;
+		bool valid = path.evaluate(t, pos, vel);
+		EXPECT_EQ(t <= 2.0, valid);
+		EXPECT_NEAR(min(t, 2.0f), pos.x, 1e-5);
+	}
+}
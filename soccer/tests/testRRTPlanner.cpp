@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+#include <planning/RRTPlanner.hpp>
+#include <Geometry2d/Circle.hpp>
+#include <Constants.hpp>
+#include <Eigen/Dense>
+#include <stdlib.h>
+
+using namespace std;
+using namespace Eigen;
+using namespace Planning;
+using namespace Geometry2d;
+
+// The dense solve that cubicBezierCalc() replaced, for one axis
+static VectorXd denseBezierCalc(double vi, double vf, vector<double> &points,
+		vector<double> &ks, vector<double> &ks2)
+{
+	int curvesNum = points.size() - 1;
+
+	int matrixSize = curvesNum*2;
+	MatrixXd equations = MatrixXd::Zero(matrixSize, matrixSize);
+	VectorXd answer(matrixSize);
+	equations(0,0) = 1;
+	answer(0) = vi/(3.0*ks[0]) + points[0];
+	equations(1,matrixSize-1) = 1;
+	answer(1) = points[curvesNum] - vf/(3*ks[curvesNum-1]);
+
+	int i = 2;
+	for (int n=0; n<curvesNum-1; n++)
+	{
+		equations(i, n*2 + 1) = ks[n];
+		equations(i, n*2 + 2) = ks[n+1];
+		answer(i) = (ks[n] + ks[n+1]) * points[n + 1];
+		i++;
+	}
+
+	for (int n=0; n<curvesNum-1; n++)
+	{
+		equations(i, n*2) = ks2[n];
+		equations(i, n*2 + 1) = -2*ks2[n];
+		equations(i, n*2 + 2) = 2*ks2[n+1];
+		equations(i, n*2 + 3) = -ks2[n+1];
+		answer(i) = points[n + 1] * (ks2[n+1] - ks2[n]);
+		i++;
+	}
+
+	ColPivHouseholderQR<MatrixXd> solver(equations);
+	return solver.solve(answer);
+}
+
+/* ************************************************************************* */
+TEST( testRRTPlanner, cubicBezierCalcMatchesDense ) {
+	srand48(4);
+
+	for (int curves = 1; curves <= 40; ++curves)
+	{
+		vector<Geometry2d::Point> points;
+		vector<double> pointsX, pointsY, ks, ks2;
+		for (int i = 0; i <= curves; ++i)
+		{
+			points.push_back(Geometry2d::Point(drand48() * 6 - 3, drand48() * 9 - 4.5));
+			pointsX.push_back(points.back().x);
+			pointsY.push_back(points.back().y);
+		}
+		for (int i = 0; i < curves; ++i)
+		{
+			ks.push_back(1 / (0.05 + drand48()));
+			ks2.push_back(ks.back() * ks.back());
+		}
+		Geometry2d::Point vi(drand48() - 0.5, drand48() - 0.5);
+		Geometry2d::Point vf;
+
+		vector<Geometry2d::Point> controls;
+		RRTPlanner::cubicBezierCalc(vi, vf, points, ks, ks2, controls);
+
+		VectorXd expectedX = denseBezierCalc(vi.x, vf.x, pointsX, ks, ks2);
+		VectorXd expectedY = denseBezierCalc(vi.y, vf.y, pointsY, ks, ks2);
+
+		ASSERT_EQ(curves * 2, (int)controls.size());
+		for (int i = 0; i < curves * 2; ++i)
+		{
+			EXPECT_NEAR(expectedX(i), controls[i].x, 1e-4);
+			EXPECT_NEAR(expectedY(i), controls[i].y, 1e-4);
+		}
+	}
+}
+
+// Exposes the waypoints of the last path, before smoothing
+class WaypointPlanner: public RRTPlanner
+{
+public:
+	const vector<Point> &waypoints() const
+	{
+		return _waypoints;
+	}
+};
+
+// Distance from @pt to the closest point on the polyline through @points
+static float polylineDistance(const vector<Point> &points, const Point &pt)
+{
+	float dist = points.empty() ? INFINITY : pt.distTo(points[0]);
+	for (unsigned int i = 1; i < points.size(); ++i)
+	{
+		dist = min(dist, Segment(points[i - 1], points[i]).distTo(pt));
+	}
+	return dist;
+}
+
+// Moves @distance along the polyline through @points from its start
+static Point alongPolyline(const vector<Point> &points, float distance)
+{
+	for (unsigned int i = 1; i < points.size(); ++i)
+	{
+		const float length = points[i - 1].distTo(points[i]);
+		if (distance <= length)
+		{
+			return points[i - 1] + (points[i] - points[i - 1]) * (distance / length);
+		}
+		distance -= length;
+	}
+	return points.back();
+}
+
+/* ************************************************************************* */
+TEST( testRRTPlanner, warmStart ) {
+	// Staggered rows of robots between the start and goal
+	const float length = Field_Dimensions::Current_Dimensions.Length();
+	const float width = Field_Dimensions::Current_Dimensions.Width();
+	CompositeShape obstacles;
+	srand48(3);
+	for (int row = 0; row < 3; ++row)
+	{
+		for (int col = 0; col < 6; ++col)
+		{
+			const float offset = (row % 2) ? 0 : 0.5f;
+			Point pos((col - 2.5f + offset) * width / 7, length / 2 + (row - 1) * 0.4f);
+			pos += Point(drand48() - 0.5, drand48() - 0.5) * 0.1f;
+			obstacles.add(std::make_shared<Circle>(pos, Robot_Radius));
+		}
+	}
+	ObstacleWorld world(obstacles);
+
+	const Point goal(0, length * 3 / 4);
+	MotionConstraints mc;
+	mc.targetPos = goal;
+
+	// One planner, replanning each frame as the robot moves along its last route
+	WaypointPlanner planner;
+	planner.maxIterations(250);
+	Point start(0, length / 4);
+	vector<Point> last;
+	int reused = 0;
+	const int frames = 30;
+	for (int i = 0; i < frames; ++i)
+	{
+		Path path;
+		planner.run(start, 0, Point(), mc, &world, path);
+		const vector<Point> &waypoints = planner.waypoints();
+
+		ASSERT_GE(waypoints.size(), 2u);
+		EXPECT_NEAR(0, waypoints.back().distTo(goal), 0.05);
+		EXPECT_NEAR(0, path.points.back().distTo(goal), 0.05);
+
+		// The route doesn't go into anything it didn't start in
+		ShapeSet startHit;
+		world.hit(start, startHit);
+		for (unsigned int j = 1; j < waypoints.size(); ++j)
+		{
+			EXPECT_FALSE(world.hitNew(Segment(waypoints[j - 1], waypoints[j]), startHit));
+		}
+
+		// When the seeded part of the last route connected without searching,
+		// the new route is part of the old one
+		if (i > 0 && planner.iterations() == 0)
+		{
+			++reused;
+			for (const Point &pt : waypoints)
+			{
+				EXPECT_LT(polylineDistance(last, pt), 0.01);
+			}
+		}
+
+		last = waypoints;
+		start = alongPolyline(waypoints, 0.1);
+	}
+
+	EXPECT_GE(reused, frames / 2);
+}
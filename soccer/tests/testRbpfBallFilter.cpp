@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+#include <modeling/RbpfBallFilter.hpp>
+#include <SystemState.hpp>
+
+using namespace Geometry2d;
+
+/* ************************************************************************* */
+TEST( testRbpfBallFilter, kick ) {
+	RbpfBallFilter filter(64);
+	EXPECT_EQ(64, filter.numParticles());
+
+	// Sitting still, then kicked at 5 m/s along +y.  Friction is ignored, since it
+	// only takes a few cm/s off over these frames.
+	const Time start = 1000000;
+	const Time period = 16667;
+	Ball ball;
+	for (int i = 0; i < 30; ++i)
+	{
+		filter.update(Point(1, 2), start + i * period, 0.01f);
+	}
+	filter.predict(start + 29 * period, &ball, 0);
+	EXPECT_NEAR(0, ball.vel.mag(), 0.05);
+
+	// The first frame after the kick is explained by a kick, not by rolling
+	for (int i = 1; i <= 3; ++i)
+	{
+		filter.update(Point(1, 2 + 5 * i * period * TimestampToSecs), start + (29 + i) * period, i == 1 ? 0.3f : 0.01f);
+		if (i == 1)
+		{
+			EXPECT_GT(filter.kickedFraction(), 0.5);
+		}
+	}
+
+	filter.predict(start + 32 * period, &ball, 0);
+	EXPECT_NEAR(0, ball.vel.x, 0.3);
+	EXPECT_NEAR(5, ball.vel.y, 0.5);
+	EXPECT_NEAR(2 + 5 * 3 * period * TimestampToSecs, ball.pos.y, 0.03);
+}
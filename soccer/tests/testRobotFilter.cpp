@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include <modeling/RobotFilter.hpp>
+#include <Utils.hpp>
+#include <stdlib.h>
+
+using namespace Geometry2d;
+
+/* ************************************************************************* */
+TEST( testRobotFilter, constantVelocity ) {
+	RobotFilter filter;
+	const int robot = RobotFilter::index(3, false);
+
+	// Moving and turning steadily, seen at 60Hz by two cameras with a little noise.
+	// The angle wraps around several times.
+	const Point vel(1, -0.5);
+	const float angleVel = 4;
+	const Time start = 1000000;
+	srand48(1);
+	for (int i = 0; i < 120; ++i)
+	{
+		float t = i / 60.0f;
+		Point noise(drand48() - 0.5, drand48() - 0.5);
+		RobotObservation obs(vel * t + noise * 0.01f, fixAngleRadians(angleVel * t + (drand48() - 0.5) * 0.02), start + t * SecsToTimestamp);
+		obs.source = i % 2;
+		filter.observe(robot, obs);
+		filter.update();
+	}
+	EXPECT_EQ(2, filter.numCameras());
+
+	// Predicted forward to when the next frame would be
+	RobotPose pose;
+	float t = 120 / 60.0f;
+	filter.predict(start + t * SecsToTimestamp, robot, pose);
+	EXPECT_TRUE(pose.visible);
+	EXPECT_NEAR(vel.x, pose.vel.x, 0.1);
+	EXPECT_NEAR(vel.y, pose.vel.y, 0.1);
+	EXPECT_NEAR((vel * t).x, pose.pos.x, 0.02);
+	EXPECT_NEAR((vel * t).y, pose.pos.y, 0.02);
+	EXPECT_NEAR(angleVel, pose.angleVel, 0.3);
+	EXPECT_NEAR(0, fixAngleRadians(angleVel * t - pose.angle), 0.05);
+
+	// Too long without a new observation
+	filter.predict(start + (t + 1) * SecsToTimestamp, robot, pose);
+	EXPECT_FALSE(pose.visible);
+
+	// Never seen
+	RobotPose other;
+	other.visible = true;
+	filter.predict(start, RobotFilter::index(3, true), other);
+	EXPECT_FALSE(other.visible);
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include <SpscQueue.hpp>
+#include <memory>
+#include <thread>
+
+using namespace std;
+
+/* ************************************************************************* */
+TEST( testSpscQueue, fullAndEmpty ) {
+	SpscQueue<int, 4> queue;
+	EXPECT_EQ(4u, queue.capacity());
+
+	int value = -1;
+	EXPECT_FALSE(queue.pop(value));
+	EXPECT_EQ(-1, value);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		value = i;
+		EXPECT_TRUE(queue.push(value));
+	}
+	EXPECT_EQ(4u, queue.size());
+
+	value = 4;
+	EXPECT_FALSE(queue.push(value));
+	EXPECT_EQ(4, value);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		EXPECT_TRUE(queue.pop(value));
+		EXPECT_EQ(i, value);
+	}
+	EXPECT_EQ(0u, queue.size());
+	EXPECT_FALSE(queue.pop(value));
+}
+
+/* ************************************************************************* */
+TEST( testSpscQueue, moveOnly ) {
+	SpscQueue<unique_ptr<int>, 2> queue;
+
+	unique_ptr<int> in(new int(5));
+	EXPECT_TRUE(queue.push(in));
+	EXPECT_FALSE(in);
+
+	// A failed push leaves the value with the caller
+	unique_ptr<int> second(new int(6)), third(new int(7));
+	EXPECT_TRUE(queue.push(second));
+	EXPECT_FALSE(queue.push(third));
+	ASSERT_TRUE(third != nullptr);
+	EXPECT_EQ(7, *third);
+
+	unique_ptr<int> out;
+	EXPECT_TRUE(queue.pop(out));
+	ASSERT_TRUE(out != nullptr);
+	EXPECT_EQ(5, *out);
+}
+
+/* ************************************************************************* */
+TEST( testSpscQueue, wraparound ) {
+	// Many times around the slots, with the queue partly full each time
+	SpscQueue<int, 8> queue;
+	int next = 0, expected = 0;
+	for (int round = 0; round < 100; ++round)
+	{
+		const int count = 1 + round % 8;
+		for (int i = 0; i < count; ++i)
+		{
+			int value = next++;
+			ASSERT_TRUE(queue.push(value));
+		}
+		EXPECT_EQ((size_t)count, queue.size());
+
+		int value;
+		for (int i = 0; i < count; ++i)
+		{
+			ASSERT_TRUE(queue.pop(value));
+			EXPECT_EQ(expected++, value);
+		}
+		EXPECT_FALSE(queue.pop(value));
+	}
+}
+
+/* ************************************************************************* */
+TEST( testSpscQueue, threads ) {
+	// A small queue, so both full and empty happen often
+	SpscQueue<int, 16> queue;
+	const int count = 1000000;
+
+	thread producer([&]()
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			int value = i;
+			while (!queue.push(value))
+			{
+				this_thread::yield();
+			}
+		}
+	});
+
+	// Everything arrives, in order
+	int expected = 0;
+	bool ordered = true;
+	while (expected < count)
+	{
+		int value;
+		if (queue.pop(value))
+		{
+			ordered = ordered && value == expected;
+			++expected;
+		} else {
+			this_thread::yield();
+		}
+	}
+	producer.join();
+
+	EXPECT_TRUE(ordered);
+	EXPECT_EQ(count, expected);
+	EXPECT_EQ(0u, queue.size());
+}
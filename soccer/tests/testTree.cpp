@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include <planning/Tree.hpp>
+#include <Geometry2d/CompositeShape.hpp>
+#include <Field_Dimensions.hpp>
+#include <stdlib.h>
+
+using namespace Geometry2d;
+using namespace Planning;
+
+/* ************************************************************************* */
+TEST( testTree, nearest ) {
+	const Field_Dimensions &dims = Field_Dimensions::Current_Dimensions;
+	CompositeShape shapes;
+	ObstacleWorld obstacles(shapes);
+
+	FixedStepTree tree;
+	tree.step = 0.15;
+	tree.init(Point(0, 1), &obstacles);
+
+	srand48(1);
+	for (int i = 0; i < 500; ++i)
+	{
+		// Include points outside the floor, which are stored in the edge cells of the grid
+		Point r(dims.FloorWidth() * 1.5 * (drand48() - 0.5), dims.FloorLength() * 1.5 * drand48() - 2);
+		tree.extend(r);
+	}
+	ASSERT_GT(tree.size(), 64);
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		Point q(dims.FloorWidth() * 2 * (drand48() - 0.5), dims.FloorLength() * 2 * drand48() - 3);
+
+		float best = -1;
+		for (int j = 0; j < tree.size(); ++j)
+		{
+			float d = (tree.point(j)->pos - q).magsq();
+			if (best < 0 || d < best)
+			{
+				best = d;
+			}
+		}
+
+		EXPECT_FLOAT_EQ(best, (tree.nearest(q)->pos - q).magsq());
+	}
+}
+
+/* ************************************************************************* */
+TEST( testTree, parentLinks ) {
+	CompositeShape shapes;
+	ObstacleWorld obstacles(shapes);
+
+	FixedStepTree tree;
+	tree.step = 0.1;
+	tree.init(Point(0, 0), &obstacles);
+	ASSERT_TRUE(tree.connect(Point(1, 0)));
+
+	Path path;
+	tree.addPath(path, tree.last());
+	ASSERT_EQ(tree.size(), path.points.size());
+	EXPECT_EQ(Point(0, 0), path.points.front());
+	EXPECT_EQ(Point(1, 0), path.points.back());
+	EXPECT_FALSE(tree.start()->leaf);
+	EXPECT_TRUE(tree.last()->leaf);
+}
@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+#include <VisionClock.hpp>
+
+/* ************************************************************************* */
+TEST( testVisionClock, minFilter ) {
+	VisionClock clock;
+
+	// Vision clock is 100s behind ours, network delay is 1-5ms,
+	// and frames take 10ms from capture to send.
+	const double Offset = 100;
+	double offset = 0;
+	for (int i = 0; i < 300; ++i)
+	{
+		double captured = i / 60.0;
+		double sent = captured + 0.010;
+		double received = sent + Offset + 0.001 + (i % 5) * 0.001;
+		offset = clock.update(0, received, sent, captured);
+	}
+
+	// The offset includes the minimum network delay
+	EXPECT_NEAR(Offset + 0.001, offset, 1e-6);
+	EXPECT_NEAR(0, clock.drift(0), 1e-6);
+
+	// Latency is capture to receive minus the minimum network delay,
+	// so 10ms plus the average jitter.
+	EXPECT_NEAR(0.012, clock.latency(0), 0.002);
+
+	// Other cameras are independent
+	EXPECT_EQ(0, clock.latency(1));
+}
+
+/* ************************************************************************* */
+TEST( testVisionClock, drift ) {
+	VisionClock clock;
+
+	// Vision clock runs 100ppm slow
+	const double Drift = 100e-6;
+	for (int i = 0; i < 600; ++i)
+	{
+		double received = i / 60.0;
+		double sent = received * (1 - Drift);
+		clock.update(2, received, sent, sent);
+	}
+
+	EXPECT_NEAR(Drift, clock.drift(2), 1e-6);
+
+	// Extrapolate one second ahead
+	double t = 11;
+	EXPECT_NEAR(t * Drift, clock.offset(2, t), 1e-6);
+}